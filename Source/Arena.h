@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    Single contiguous allocation for per-channel DSP state.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <type_traits>
+
+//==============================================================================
+// Bump allocator over one cache aligned block. Objects are constructed in
+// place and never destroyed, so only trivially destructible types are allowed.
+//
+// The same allocation code runs twice: once after beginMeasure(), when
+// allocate() only counts bytes and returns nullptr, and once after
+// allocateMemory() with the measured size.
+class Arena
+{
+public:
+	Arena() {};
+
+	static const size_t ALIGNMENT = 64;
+
+	void beginMeasure()
+	{
+		m_memory.free();
+		m_base = nullptr;
+		m_capacity = 0;
+		m_used = 0;
+	}
+
+	void allocateMemory(size_t bytes)
+	{
+		m_memory.allocate(bytes + ALIGNMENT, true);
+		m_base = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(m_memory.get()) + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+		m_capacity = bytes;
+		m_used = 0;
+	}
+
+	template <typename T>
+	T* allocate(int count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+		static_assert(alignof(T) <= ALIGNMENT, "Arena alignment is too small");
+
+		const size_t offset = (m_used + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		m_used = offset + sizeof(T) * (size_t)count;
+
+		if (m_base == nullptr)
+			return nullptr;
+
+		jassert(m_used <= m_capacity);
+
+		T* objects = reinterpret_cast<T*>(m_base + offset);
+
+		for (int i = 0; i < count; ++i)
+			new (objects + i) T();
+
+		return objects;
+	}
+
+	size_t getUsedBytes() const { return m_used; }
+
+private:
+	juce::HeapBlock<char> m_memory;
+	char* m_base = nullptr;
+	size_t m_capacity = 0;
+	size_t m_used = 0;
+};
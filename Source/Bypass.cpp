@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    Host bypass: latency-matched dry path and crossfades.
+
+  ==============================================================================
+*/
+
+#include "Bypass.h"
+
+//==============================================================================
+const float Bypass::FADE_MS = 10.0f;
+
+void Bypass::prepare(Arena& arena, int channels, int sampleRate, int maxBlock, int maxLatency, bool doublePrecision)
+{
+	m_channels = channels;
+	m_fadeLength = juce::jmax(1, (int)std::round(FADE_MS * 0.001f * sampleRate));
+
+	m_capacity = 1;
+
+	while (m_capacity < juce::jmax(1, maxBlock) + maxLatency)
+		m_capacity *= 2;
+
+	std::get<float*>(m_delay) = doublePrecision ? nullptr : arena.allocate<float>(m_capacity * channels);
+	std::get<double*>(m_delay) = doublePrecision ? arena.allocate<double>(m_capacity * channels) : nullptr;
+}
+
+void Bypass::reset(bool bypassed)
+{
+	m_target = bypassed ? m_fadeLength : 0;
+	m_position = m_target;
+	m_hold = 0;
+	m_writeIndex = 0;
+	m_blockStart = 0;
+
+	if (std::get<float*>(m_delay) != nullptr)
+		std::fill(std::get<float*>(m_delay), std::get<float*>(m_delay) + m_capacity * m_channels, 0.0f);
+
+	if (std::get<double*>(m_delay) != nullptr)
+		std::fill(std::get<double*>(m_delay), std::get<double*>(m_delay) + m_capacity * m_channels, 0.0);
+}
+
+//==============================================================================
+template <typename SampleType>
+void Bypass::pushInput(SampleType* const* channels, int numChannels, int numSamples)
+{
+	jassert(numChannels <= m_channels);
+
+	const int mask = m_capacity - 1;
+
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		SampleType* delay = std::get<SampleType*>(m_delay) + channel * m_capacity;
+		const SampleType* in = channels[channel];
+
+		// At most two runs, around the end of the ring
+		const int first = juce::jmin(numSamples, m_capacity - m_writeIndex);
+		std::copy(in, in + first, delay + m_writeIndex);
+
+		for (int sample = first; sample < numSamples; ++sample)
+			delay[(m_writeIndex + sample) & mask] = in[sample];
+	}
+
+	m_blockStart = m_writeIndex;
+	m_writeIndex = (m_writeIndex + numSamples) & mask;
+}
+
+template <typename SampleType>
+void Bypass::processBypassed(SampleType* const* channels, int numChannels, int numSamples, int latency)
+{
+	jassert(numSamples + latency <= m_capacity);
+
+	// The input is still in place
+	if (latency == 0)
+		return;
+
+	const int mask = m_capacity - 1;
+
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		const SampleType* delay = getDelay<SampleType>(channel);
+		SampleType* out = channels[channel];
+
+		for (int sample = 0; sample < numSamples; ++sample)
+			out[sample] = delay[(m_blockStart + m_capacity - latency + sample) & mask];
+	}
+}
+
+template <typename SampleType>
+void Bypass::mix(SampleType* const* channels, int numChannels, int numSamples, int latency)
+{
+	jassert(numSamples + latency <= m_capacity);
+
+	const int mask = m_capacity - 1;
+	const int step = (m_target > m_position) ? 1 : -1;
+	const SampleType scale = SampleType(1) / (SampleType)m_fadeLength;
+
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		const SampleType* delay = getDelay<SampleType>(channel);
+		SampleType* out = channels[channel];
+		int position = m_position;
+		int hold = m_hold;
+
+		for (int sample = 0; sample < numSamples; ++sample)
+		{
+			if (hold > 0)
+				--hold;
+			else if (position != m_target)
+				position += step;
+
+			const SampleType dry = delay[(m_blockStart + m_capacity - latency + sample) & mask];
+			out[sample] += (SampleType)position * scale * (dry - out[sample]);
+		}
+	}
+
+	const int moving = juce::jmax(0, numSamples - m_hold);
+	m_hold = juce::jmax(0, m_hold - numSamples);
+	m_position = (step > 0) ? juce::jmin(m_target, m_position + moving) : juce::jmax(m_target, m_position - moving);
+}
+
+template void Bypass::pushInput<float>(float* const*, int, int);
+template void Bypass::pushInput<double>(double* const*, int, int);
+template void Bypass::processBypassed<float>(float* const*, int, int, int);
+template void Bypass::processBypassed<double>(double* const*, int, int, int);
+template void Bypass::mix<float>(float* const*, int, int, int);
+template void Bypass::mix<double>(double* const*, int, int, int);
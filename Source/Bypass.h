@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    Host bypass: latency-matched dry path and crossfades.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Arena.h"
+#include <tuple>
+
+//==============================================================================
+// Every block's input is kept in a delay line, so the dry signal can be read
+// back delayed by the processing latency. Switching bypass fades linearly
+// between the processed and the delayed dry signal over FADE_MS. Once the fade
+// has reached the dry side the processing is skipped and the block is only
+// the delayed input.
+//
+// The delay lines hold one prepared block plus the largest latency, longer
+// blocks have to be split by the caller. Only the precision in use is
+// allocated.
+class Bypass
+{
+public:
+	Bypass() {};
+
+	static const float FADE_MS;
+
+	// Takes the delay lines from the arena, call from prepareToPlay. In the
+	// arena's measuring pass nothing is set up.
+	void prepare(Arena& arena, int channels, int sampleRate, int maxBlock, int maxLatency, bool doublePrecision);
+
+	// Clears the delay lines and jumps to the given state without a fade
+	void reset(bool bypassed);
+
+	// Fades towards bypassed from the current position
+	void set(bool bypassed) { m_target = bypassed ? m_fadeLength : 0; }
+
+	// Leaving full bypass the processing first outputs what its delay lines
+	// held from before, so the fade in waits for latency samples
+	void resume(int latency) { m_hold = latency; }
+
+	// Fully bypassed, the processing can be skipped
+	bool isBypassed() const { return m_position == m_fadeLength && m_target == m_fadeLength; }
+
+	// The processed block needs to be mixed with the dry signal
+	bool isFading() const { return m_position != 0 || m_target != 0; }
+
+	// Stores the input, call before the block is processed in place
+	template <typename SampleType>
+	void pushInput(SampleType* const* channels, int numChannels, int numSamples);
+
+	// Replaces the block with its input delayed by latency samples
+	template <typename SampleType>
+	void processBypassed(SampleType* const* channels, int numChannels, int numSamples, int latency);
+
+	// Crossfades the processed block with its input delayed by latency samples
+	template <typename SampleType>
+	void mix(SampleType* const* channels, int numChannels, int numSamples, int latency);
+
+private:
+	template <typename SampleType>
+	const SampleType* getDelay(int channel) const { return std::get<SampleType*>(m_delay) + channel * m_capacity; }
+
+	int m_channels = 0;
+	int m_fadeLength = 1;
+
+	// Fade position and target in samples, 0 processed and m_fadeLength dry
+	int m_position = 0;
+	int m_target = 0;
+	int m_hold = 0;
+
+	// Input of each channel, m_capacity a power of two. m_blockStart is where
+	// the last pushed block starts.
+	std::tuple<float*, double*> m_delay;
+	int m_capacity = 0;
+	int m_writeIndex = 0;
+	int m_blockStart = 0;
+};
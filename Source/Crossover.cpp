@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    Linkwitz-Riley crossover for the channel-parallel multiband kernel.
+
+  ==============================================================================
+*/
+
+#include "Crossover.h"
+
+//==============================================================================
+void Crossover::init(int sampleRate)
+{
+	m_sampleRate = sampleRate;
+	m_bands = 1;
+
+	// Force the next set() to recalculate
+	for (auto& frequency : m_frequencies)
+		frequency = -1.0f;
+}
+
+void Crossover::set(int bands, const float* frequencies)
+{
+	m_bands = bands < 1 ? 1 : (bands > MAX_BANDS ? MAX_BANDS : bands);
+
+	for (int split = 0; split < m_bands - 1; ++split)
+	{
+		if (frequencies[split] != m_frequencies[split])
+		{
+			m_frequencies[split] = frequencies[split];
+			calculateSplit(split, frequencies[split]);
+		}
+	}
+}
+
+void Crossover::calculateSplit(int split, float frequency)
+{
+	// Butterworth sections, bilinear transform with prewarping
+	const double Q = 0.70710678118654752;
+	const double frequencyLimited = std::fmin((double)frequency, 0.49 * (double)m_sampleRate);
+	const double K = std::tan(3.14159265358979324 * frequencyLimited / (double)m_sampleRate);
+	const double norm = 1.0 / (1.0 + K / Q + K * K);
+	const double a1 = 2.0 * (K * K - 1.0) * norm;
+	const double a2 = (1.0 - K / Q + K * K) * norm;
+
+	auto& lowPass = m_lowPass[split];
+	lowPass.b0 = Float4::broadcast((float)(K * K * norm));
+	lowPass.b1 = Float4::broadcast((float)(2.0 * K * K * norm));
+	lowPass.b2 = lowPass.b0;
+	lowPass.a1 = Float4::broadcast((float)a1);
+	lowPass.a2 = Float4::broadcast((float)a2);
+
+	auto& highPass = m_highPass[split];
+	highPass.b0 = Float4::broadcast((float)norm);
+	highPass.b1 = Float4::broadcast((float)(-2.0 * norm));
+	highPass.b2 = highPass.b0;
+	highPass.a1 = lowPass.a1;
+	highPass.a2 = lowPass.a2;
+
+	// What the Linkwitz-Riley pair sums to
+	auto& allPass = m_allPass[split];
+	allPass.b0 = lowPass.a2;
+	allPass.b1 = lowPass.a1;
+	allPass.b2 = Float4::broadcast(1.0f);
+	allPass.a1 = lowPass.a1;
+	allPass.a2 = lowPass.a2;
+}
@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    Linkwitz-Riley crossover for the channel-parallel multiband kernel.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "SIMD.h"
+
+//==============================================================================
+// Splits up to Float4::size channels, one per lane, into up to MAX_BANDS bands.
+// Each split is a 4th order Linkwitz-Riley pair, two Butterworth sections per
+// side, applied to the high side of the split below it. The pair sums to a
+// 2nd order allpass, so lower bands pass through that allpass for every split
+// above them and all bands add up to an allpass response.
+//
+// Coefficients are shared by all lanes, the filter memory lives in State so one
+// Crossover serves every channel group.
+class Crossover
+{
+public:
+	Crossover() {};
+
+	static const int MAX_BANDS = 4;
+	static const int MAX_SPLITS = MAX_BANDS - 1;
+
+	// Four sections per split, plus the allpasses of bands 0 and 1
+	static const int SECTIONS = 4 * MAX_SPLITS + 3;
+
+	struct State
+	{
+		Float4 z1[SECTIONS];
+		Float4 z2[SECTIONS];
+
+		void reset() { *this = State(); }
+	};
+
+	void init(int sampleRate);
+
+	// Split frequencies in Hz, ascending, bands - 1 of them. Coefficients are
+	// only recalculated when they change.
+	void set(int bands, const float* frequencies);
+
+	int getNumBands() const { return m_bands; }
+
+	// Bands at and above getNumBands() are zero
+	inline void split(State& state, Float4 in, Float4* bands) const
+	{
+		Float4 rest = in;
+
+		for (int i = 0; i < m_bands - 1; ++i)
+		{
+			const Float4 low = process(m_lowPass[i], process(m_lowPass[i], rest, state, 4 * i), state, 4 * i + 1);
+			rest = process(m_highPass[i], process(m_highPass[i], rest, state, 4 * i + 2), state, 4 * i + 3);
+			bands[i] = low;
+		}
+
+		bands[m_bands - 1] = rest;
+
+		for (int i = m_bands; i < MAX_BANDS; ++i)
+			bands[i] = Float4::zero();
+
+		// Phase compensation for the splits above each band
+		if (m_bands > 2)
+			bands[0] = process(m_allPass[1], bands[0], state, 4 * MAX_SPLITS);
+
+		if (m_bands > 3)
+		{
+			bands[0] = process(m_allPass[2], bands[0], state, 4 * MAX_SPLITS + 1);
+			bands[1] = process(m_allPass[2], bands[1], state, 4 * MAX_SPLITS + 2);
+		}
+	}
+
+private:
+	struct Section
+	{
+		Float4 b0 = Float4::zero();
+		Float4 b1 = Float4::zero();
+		Float4 b2 = Float4::zero();
+		Float4 a1 = Float4::zero();
+		Float4 a2 = Float4::zero();
+	};
+
+	// Same structure as BiquadLowPassFilter::process
+	static inline Float4 process(const Section& section, Float4 in, State& state, int index)
+	{
+		const Float4 out = in * section.b0 + state.z1[index];
+		state.z1[index] = in * section.b1 + state.z2[index] - section.a1 * out;
+		state.z2[index] = in * section.b2 - section.a2 * out;
+		return out;
+	}
+
+	void calculateSplit(int split, float frequency);
+
+	int m_sampleRate = 48000;
+	int m_bands = 1;
+	float m_frequencies[MAX_SPLITS] = {};
+
+	Section m_lowPass[MAX_SPLITS];
+	Section m_highPass[MAX_SPLITS];
+	Section m_allPass[MAX_SPLITS];
+};
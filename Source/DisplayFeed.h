@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+    Curve parameters and levels for the editor, pushed by the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// State of one processed block
+struct DisplayFrame
+{
+	// Shaper exponent and the gains mixing it with the dry signal
+	float exponent = 1.0f;
+	float wetGain = 1.0f;
+	float dryGain = 0.0f;
+
+	// Peak levels over the block
+	float inputLevel = 0.0f;
+	float outputLevel = 0.0f;
+};
+
+//==============================================================================
+// Single producer, single consumer. The audio thread pushes one frame per block
+// and drops it when the FIFO is full. The reader takes everything pending at
+// its own frame rate, so the audio thread never waits for the editor.
+class DisplayFeed
+{
+public:
+	DisplayFeed() {};
+
+	static const int FIFO_SIZE = 256;
+
+	// Audio thread
+	void push(const DisplayFrame& frame)
+	{
+		const auto scope = m_fifo.write(1);
+
+		if (scope.blockSize1 + scope.blockSize2 > 0)
+			m_fifoData[scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2] = frame;
+	}
+
+	// Reader thread. Curve parameters of the latest frame and the highest levels
+	// of all pending frames, false when nothing arrived since the last call.
+	bool collect(DisplayFrame& frame)
+	{
+		const auto scope = m_fifo.read(m_fifo.getNumReady());
+
+		if (scope.blockSize1 + scope.blockSize2 == 0)
+			return false;
+
+		float inputLevel = 0.0f;
+		float outputLevel = 0.0f;
+
+		scope.forEach([this, &frame, &inputLevel, &outputLevel](int index)
+		{
+			frame = m_fifoData[index];
+			inputLevel = juce::jmax(inputLevel, frame.inputLevel);
+			outputLevel = juce::jmax(outputLevel, frame.outputLevel);
+		});
+
+		frame.inputLevel = inputLevel;
+		frame.outputLevel = outputLevel;
+		return true;
+	}
+
+private:
+	juce::AbstractFifo m_fifo{ FIFO_SIZE };
+	DisplayFrame m_fifoData[FIFO_SIZE];
+};
@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+
+    Kaiser window for the windowed sinc filter designs.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Used at design time only, in double precision
+namespace KaiserWindow
+{
+	// Zeroth order modified Bessel function of the first kind. The series has
+	// converged after 32 terms for the betas used here.
+	inline double besselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (0.5 * x / k) * (0.5 * x / k);
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	// Window value at ratio of the half span from the centre, 1 at the centre
+	// and besselI0(0) / besselI0(beta) at |ratio| = 1
+	inline double get(double ratio, double beta)
+	{
+		return besselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - ratio * ratio))) / besselI0(beta);
+	}
+}
@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    Lookahead true-peak limiter, linked across channels.
+
+  ==============================================================================
+*/
+
+#include "Limiter.h"
+#include "KaiserWindow.h"
+
+//==============================================================================
+const float Limiter::CEILING = 1.0f;
+const float Limiter::RELEASE_MS = 50.0f;
+const float Limiter::MAX_LOOKAHEAD_MS = 10.0f;
+
+//==============================================================================
+void Limiter::prepare(Arena& arena, int channels, int sampleRate, bool doublePrecision)
+{
+	m_sampleRate = sampleRate;
+	m_channels = channels;
+	m_maxLookahead = juce::jmax(1, (int)std::ceil(MAX_LOOKAHEAD_MS * 0.001f * sampleRate));
+	m_windowCapacity = m_maxLookahead + 1;
+	m_delayCapacity = m_maxLookahead + DETECTOR_DELAY;
+	m_releaseCoef = std::exp(-1000.0f / (RELEASE_MS * sampleRate));
+
+	// The lookahead in samples belongs to the previous rate, the next set()
+	// starts over from reset()
+	m_enabled = false;
+	m_lookahead = 0;
+
+	// Kaiser windowed sinc between the two centre taps, each phase normalised
+	// to unity gain at DC
+	static const double beta = 5.0;
+	const double pi = juce::MathConstants<double>::pi;
+	const double halfSpan = 0.5 * TRUE_PEAK_TAPS;
+
+	for (int phase = 1; phase < OVERSAMPLING; ++phase)
+	{
+		const double fraction = (double)phase / OVERSAMPLING;
+		double taps[TRUE_PEAK_TAPS] = {};
+		double sum = 0.0;
+
+		for (int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+		{
+			const double distance = tap - (TRUE_PEAK_TAPS / 2 - 1) - fraction;
+			const double ratio = distance / halfSpan;
+			const double window = KaiserWindow::get(ratio, beta);
+
+			taps[tap] = std::sin(pi * distance) / (pi * distance) * window;
+			sum += taps[tap];
+		}
+
+		for (int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+			m_coefficients[phase - 1][tap] = (float)(taps[tap] / sum);
+	}
+
+	m_history = arena.allocate<float>(2 * TRUE_PEAK_TAPS * channels);
+	m_windowGain = arena.allocate<float>(m_windowCapacity);
+	m_windowTime = arena.allocate<juce::int64>(m_windowCapacity);
+	m_gainHistory = arena.allocate<float>(m_windowCapacity);
+	m_average = arena.allocate<float>(m_maxLookahead);
+
+	std::get<float*>(m_delay) = doublePrecision ? nullptr : arena.allocate<float>(m_delayCapacity * channels);
+	std::get<double*>(m_delay) = doublePrecision ? arena.allocate<double>(m_delayCapacity * channels) : nullptr;
+
+	if (m_history != nullptr)
+		reset();
+}
+
+void Limiter::set(bool enabled, float lookaheadMs)
+{
+	const int lookahead = juce::jlimit(1, m_maxLookahead, (int)std::round(lookaheadMs * 0.001f * m_sampleRate));
+
+	if (enabled == m_enabled && lookahead == m_lookahead)
+		return;
+
+	if (enabled != m_enabled)
+	{
+		m_enabled = enabled;
+		m_lookahead = lookahead;
+		reset();
+	}
+	else
+	{
+		const bool longer = lookahead > m_lookahead;
+		setAverageLength(lookahead);
+
+		if (longer)
+			extendWindow();
+	}
+}
+
+void Limiter::setAverageLength(int lookahead)
+{
+	const int previous = m_lookahead;
+	m_lookahead = lookahead;
+	jassert(previous <= m_maxLookahead);
+
+	if (m_average == nullptr || previous == 0)
+		return;
+
+	// Oldest to newest from the start of the ring
+	std::rotate(m_average, m_average + m_averageIndex, m_average + previous);
+
+	if (lookahead < previous)
+	{
+		std::copy(m_average + previous - lookahead, m_average + previous, m_average);
+	}
+	else
+	{
+		std::copy_backward(m_average, m_average + previous, m_average + lookahead);
+		std::fill(m_average, m_average + lookahead - previous, m_average[lookahead - previous]);
+	}
+
+	m_averageIndex = 0;
+	m_averageSum = 0.0;
+
+	for (int i = 0; i < lookahead; ++i)
+		m_averageSum += (double)m_average[i];
+}
+
+void Limiter::extendWindow()
+{
+	if (m_windowGain == nullptr)
+		return;
+
+	m_windowFront = 0;
+	m_windowSize = 0;
+
+	for (juce::int64 time = juce::jmax((juce::int64)0, m_time - m_lookahead); time < m_time; ++time)
+		insertWindow(m_gainHistory[time % m_windowCapacity], time);
+
+	if (m_windowSize == 0)
+		return;
+
+	const float minimum = m_windowGain[m_windowFront];
+	m_envelope = juce::jmin(m_envelope, minimum);
+	m_averageSum = 0.0;
+
+	for (int i = 0; i < m_lookahead; ++i)
+	{
+		m_average[i] = juce::jmin(m_average[i], minimum);
+		m_averageSum += (double)m_average[i];
+	}
+}
+
+void Limiter::reset()
+{
+	if (m_history == nullptr)
+		return;
+
+	std::fill(m_history, m_history + 2 * TRUE_PEAK_TAPS * m_channels, 0.0f);
+	m_historyIndex = 0;
+	m_lastSegmentPeak = 0.0f;
+
+	m_windowFront = 0;
+	m_windowSize = 0;
+	m_time = 0;
+
+	// Starts at unity gain
+	m_envelope = 1.0f;
+	std::fill(m_average, m_average + m_maxLookahead, 1.0f);
+	m_averageIndex = 0;
+	m_averageSum = (double)m_lookahead;
+
+	if (auto* delay = std::get<float*>(m_delay))
+		std::fill(delay, delay + m_delayCapacity * m_channels, 0.0f);
+
+	if (auto* delay = std::get<double*>(m_delay))
+		std::fill(delay, delay + m_delayCapacity * m_channels, 0.0);
+
+	m_delayIndex = 0;
+}
+
+//==============================================================================
+inline float Limiter::getSegmentPeak(int channel, float in)
+{
+	float* history = m_history + 2 * TRUE_PEAK_TAPS * channel;
+	history[m_historyIndex] = in;
+	history[m_historyIndex + TRUE_PEAK_TAPS] = in;
+
+	// Oldest to newest input
+	const float* taps = history + m_historyIndex + 1;
+	float peak = std::abs(taps[TRUE_PEAK_TAPS / 2]);
+
+	for (int phase = 0; phase < OVERSAMPLING - 1; ++phase)
+	{
+		float sum = 0.0f;
+
+		for (int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+			sum += m_coefficients[phase][tap] * taps[tap];
+
+		peak = juce::jmax(peak, std::abs(sum));
+	}
+
+	return peak;
+}
+
+inline void Limiter::insertWindow(float gain, juce::int64 time)
+{
+	// Entries at or above the new gain can never be the minimum again
+	while (m_windowSize > 0 && m_windowGain[(m_windowFront + m_windowSize - 1) % m_windowCapacity] >= gain)
+		--m_windowSize;
+
+	const int back = (m_windowFront + m_windowSize) % m_windowCapacity;
+	m_windowGain[back] = gain;
+	m_windowTime[back] = time;
+	++m_windowSize;
+}
+
+inline float Limiter::pushWindow(float gain)
+{
+	m_gainHistory[m_time % m_windowCapacity] = gain;
+	insertWindow(gain, m_time);
+
+	// Window covers the last lookahead + 1 samples, after a shorter lookahead
+	// more than one entry can drop out
+	while (m_windowTime[m_windowFront] < m_time - m_lookahead)
+	{
+		m_windowFront = (m_windowFront + 1) % m_windowCapacity;
+		--m_windowSize;
+	}
+
+	++m_time;
+	return m_windowGain[m_windowFront];
+}
+
+template <typename SampleType>
+void Limiter::process(SampleType* const* channels, int numChannels, int numSamples)
+{
+	jassert(numChannels <= m_channels);
+
+	SampleType* delay = std::get<SampleType*>(m_delay);
+
+	if (!m_enabled || delay == nullptr)
+		return;
+
+	const int delayLength = m_lookahead + DETECTOR_DELAY;
+	const double averageScale = 1.0 / (double)m_lookahead;
+	const SampleType ceiling = (SampleType)CEILING;
+
+	for (int sample = 0; sample < numSamples; ++sample)
+	{
+		// Linked true peak
+		float segmentPeak = 0.0f;
+
+		for (int channel = 0; channel < numChannels; ++channel)
+			segmentPeak = juce::jmax(segmentPeak, getSegmentPeak(channel, (float)channels[channel][sample]));
+
+		m_historyIndex = (m_historyIndex + 1) % TRUE_PEAK_TAPS;
+
+		const float peak = juce::jmax(segmentPeak, m_lastSegmentPeak);
+		m_lastSegmentPeak = segmentPeak;
+
+		// Gain needed, lowest over the window, release and moving average
+		const float windowGain = pushWindow(peak > CEILING ? CEILING / peak : 1.0f);
+		m_envelope = (windowGain < m_envelope) ? windowGain : windowGain + m_releaseCoef * (m_envelope - windowGain);
+
+		m_averageSum += (double)m_envelope - (double)m_average[m_averageIndex];
+		m_average[m_averageIndex] = m_envelope;
+		m_averageIndex = (m_averageIndex + 1) % m_lookahead;
+
+		const SampleType gain = (SampleType)(m_averageSum * averageScale);
+
+		// Delay, apply gain and clip what rounding leaves above the ceiling.
+		// Read before write, the two meet at the largest lookahead.
+		const int readIndex = (m_delayIndex + m_delayCapacity - delayLength) % m_delayCapacity;
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			SampleType* channelDelay = delay + channel * m_delayCapacity;
+			const SampleType out = channelDelay[readIndex] * gain;
+			channelDelay[m_delayIndex] = channels[channel][sample];
+			channels[channel][sample] = juce::jlimit(-ceiling, ceiling, out);
+		}
+
+		m_delayIndex = (m_delayIndex + 1) % m_delayCapacity;
+	}
+}
+
+template void Limiter::process<float>(float* const*, int, int);
+template void Limiter::process<double>(double* const*, int, int);
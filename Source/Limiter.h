@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    Lookahead true-peak limiter, linked across channels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Arena.h"
+#include <tuple>
+
+//==============================================================================
+// Detection runs in float on every channel: the input is interpolated 4x with
+// a windowed sinc of TRUE_PEAK_TAPS taps per phase, and the peak of a sample
+// is the largest of the sample and the points interpolated on either side of
+// it. The loudest channel sets the gain needed to keep the peak at CEILING.
+//
+// A sliding window minimum over lookahead + 1 samples, kept in a monotonic
+// deque, is the lowest gain any sample in the window needs. After the release
+// follower a moving average over lookahead samples ramps the gain. Every
+// sample in that average is at or below the gain the delayed peak needs, so
+// the detected peak of the output never exceeds CEILING. Like any 4x true-peak
+// meter the detector can read a little low on transients close to Nyquist.
+// Everything is O(1) per sample.
+//
+// The audio is delayed by the lookahead plus the detector delay, which is the
+// latency reported by getLatency(). The delay lines hold the largest lookahead,
+// so a lookahead change only moves the read position: the audio skips or
+// repeats the difference instead of dropping out. A shorter lookahead trims
+// the window and the average. A longer one rebuilds the window from the gain
+// history and lowers the average to its minimum, so the repeated samples are
+// covered. Only the delay lines of the processing precision in use are
+// allocated.
+class Limiter
+{
+public:
+	Limiter() {};
+
+	static const float CEILING;
+	static const float RELEASE_MS;
+	static const float MAX_LOOKAHEAD_MS;
+
+	static const int OVERSAMPLING = 4;
+	static const int TRUE_PEAK_TAPS = 12;
+
+	// Designs the interpolator and takes the channel state from the arena,
+	// call from prepareToPlay. In the arena's measuring pass nothing is set up.
+	// Leaves the limiter off until the next set().
+	void prepare(Arena& arena, int channels, int sampleRate, bool doublePrecision);
+
+	// Lookahead is limited to MAX_LOOKAHEAD_MS. Does not allocate; resets the
+	// state when the limiter is switched on or off.
+	void set(bool enabled, float lookaheadMs);
+	void reset();
+
+	bool isEnabled() const { return m_enabled; }
+
+	// Samples of delay while enabled
+	int getLatency() const { return m_enabled ? m_lookahead + DETECTOR_DELAY : 0; }
+	int getMaxLatency() const { return m_maxLookahead + DETECTOR_DELAY; }
+
+	// In place, numChannels up to the prepared channel count
+	template <typename SampleType>
+	void process(SampleType* const* channels, int numChannels, int numSamples);
+
+private:
+	// Centre of the interpolator, plus the segment after the sample
+	static const int DETECTOR_DELAY = TRUE_PEAK_TAPS / 2;
+
+	// Largest interpolated or sampled magnitude between the previous sample
+	// and the newest sample entering the centre of the interpolator
+	inline float getSegmentPeak(int channel, float in);
+
+	// Sliding window minimum of the needed gain
+	inline float pushWindow(float gain);
+	inline void insertWindow(float gain, juce::int64 time);
+
+	// Refills the window from the gain history after the lookahead grew, and
+	// keeps the envelope and the average at or below its minimum
+	void extendWindow();
+
+	// Keeps the newest entries of the moving average, older ones are padded
+	// with the oldest gain. O(lookahead), only on lookahead changes.
+	void setAverageLength(int lookahead);
+
+	int m_sampleRate = 48000;
+	int m_channels = 0;
+	int m_maxLookahead = 0;
+	bool m_enabled = false;
+	int m_lookahead = 0;
+	float m_releaseCoef = 0.0f;
+
+	// Phases 1 to OVERSAMPLING - 1, phase 0 is the centre sample itself
+	float m_coefficients[OVERSAMPLING - 1][TRUE_PEAK_TAPS] = {};
+
+	// Interpolator input of each channel, written twice so the taps are
+	// always contiguous
+	float* m_history = nullptr;
+	int m_historyIndex = 0;
+	float m_lastSegmentPeak = 0.0f;
+
+	// Monotonic deque of (gain, time), increasing gain from front to back.
+	// The needed gain of the last m_windowCapacity samples, indexed by time.
+	float* m_windowGain = nullptr;
+	juce::int64* m_windowTime = nullptr;
+	float* m_gainHistory = nullptr;
+	int m_windowCapacity = 0;
+	int m_windowFront = 0;
+	int m_windowSize = 0;
+	juce::int64 m_time = 0;
+
+	// Release follower and moving average
+	float m_envelope = 1.0f;
+	float* m_average = nullptr;
+	int m_averageIndex = 0;
+	double m_averageSum = 0.0;
+
+	// Audio delay of each channel
+	std::tuple<float*, double*> m_delay;
+	int m_delayCapacity = 0;
+	int m_delayIndex = 0;
+};
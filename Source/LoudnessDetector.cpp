@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    Level detectors for gain compensation: peak, windowed RMS and K-weighted.
+
+  ==============================================================================
+*/
+
+#include "LoudnessDetector.h"
+
+//==============================================================================
+void KWeighting::design(double sampleRate, Coefficients& shelf, Coefficients& highPass)
+{
+	const double pi = juce::MathConstants<double>::pi;
+
+	// High shelf, +4 dB above about 1.7 kHz
+	{
+		const double f0 = 1681.974450955533;
+		const double gain = 3.999843853973347;
+		const double Q = 0.7071752369554196;
+
+		const double K = std::tan(pi * f0 / sampleRate);
+		const double Vh = std::pow(10.0, gain / 20.0);
+		const double Vb = std::pow(Vh, 0.4996667741545416);
+		const double a0 = 1.0 + K / Q + K * K;
+
+		shelf.b0 = (float)((Vh + Vb * K / Q + K * K) / a0);
+		shelf.b1 = (float)(2.0 * (K * K - Vh) / a0);
+		shelf.b2 = (float)((Vh - Vb * K / Q + K * K) / a0);
+		shelf.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+		shelf.a2 = (float)((1.0 - K / Q + K * K) / a0);
+	}
+
+	// RLB high pass at about 38 Hz
+	{
+		const double f0 = 38.13547087602444;
+		const double Q = 0.5003270373238773;
+
+		const double K = std::tan(pi * f0 / sampleRate);
+		const double a0 = 1.0 + K / Q + K * K;
+
+		highPass.b0 = 1.0f;
+		highPass.b1 = -2.0f;
+		highPass.b2 = 1.0f;
+		highPass.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+		highPass.a2 = (float)((1.0 - K / Q + K * K) / a0);
+	}
+}
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    Level detectors for gain compensation: peak, windowed RMS and K-weighted.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// What the gain computer compares between input and output. Peak follows the
+// largest sample of each gain interval. The other two average the energy over
+// a window of whole gain intervals, K-weighted first filters both signals with
+// the ITU-R BS.1770 curve, so it tracks loudness in the LUFS sense (ungated).
+enum class DetectorMode
+{
+	peak = 0,
+	rms,
+	kWeighted
+};
+
+//==============================================================================
+// ITU-R BS.1770 pre-filter, a high shelf followed by the RLB high pass, each
+// as a transposed direct form II biquad. The analog prototypes are the ones
+// that reproduce the 48 kHz coefficients of the standard.
+namespace KWeighting
+{
+	struct Coefficients
+	{
+		float b0 = 1.0f;
+		float b1 = 0.0f;
+		float b2 = 0.0f;
+		float a1 = 0.0f;
+		float a2 = 0.0f;
+	};
+
+	void design(double sampleRate, Coefficients& shelf, Coefficients& highPass);
+
+	template <typename SampleType>
+	inline SampleType processStage(SampleType in, const Coefficients& c, SampleType& z1, SampleType& z2)
+	{
+		const SampleType out = in * (SampleType)c.b0 + z1;
+		z1 = in * (SampleType)c.b1 + z2 - (SampleType)c.a1 * out;
+		z2 = in * (SampleType)c.b2 - (SampleType)c.a2 * out;
+		return out;
+	}
+}
+
+//==============================================================================
+// Sum of the last `length` interval energies in a ring of `capacity` entries,
+// one add and one subtract per interval whatever the length. Float rounding
+// of the running sum is bounded by replacing it, every `length` pushes, with
+// a second sum that started empty and so holds exactly the window.
+//
+// The ring is owned by the caller, preallocated for the longest window. Only
+// the `filled` newest entries are valid, so a reset does not need to clear it.
+template <typename ValueType>
+struct LoudnessWindowState
+{
+	ValueType sum = ValueType();
+	ValueType fresh = ValueType();
+	int index = 0;
+	int filled = 0;
+	int length = 1;
+	int sinceFresh = 0;
+};
+
+namespace LoudnessWindow
+{
+	// Longest window, the rings are sized for it
+	static const int MAX_MILLISECONDS = 3000;
+
+	// Entry pushed `age` intervals ago, 0 being the newest
+	template <typename ValueType>
+	inline ValueType& getEntry(const LoudnessWindowState<ValueType>& state, ValueType* ring, int capacity, int age)
+	{
+		const int index = state.index - 1 - age;
+		return ring[index < 0 ? index + capacity : index];
+	}
+
+	// Adds or drops the entries between the old and new length. Costs one
+	// operation per interval of change, so it only runs when the length does.
+	template <typename ValueType>
+	void setLength(LoudnessWindowState<ValueType>& state, ValueType* ring, int capacity, int length)
+	{
+		jassert(length >= 1 && length <= capacity);
+
+		for (int age = state.length; age < juce::jmin(length, state.filled); ++age)
+			state.sum = state.sum + getEntry(state, ring, capacity, age);
+
+		for (int age = length; age < juce::jmin(state.length, state.filled); ++age)
+			state.sum = state.sum - getEntry(state, ring, capacity, age);
+
+		state.length = length;
+		state.fresh = ValueType();
+		state.sinceFresh = 0;
+	}
+
+	// Returns the sum over the window including energy
+	template <typename ValueType>
+	inline ValueType push(LoudnessWindowState<ValueType>& state, ValueType* ring, int capacity, int length, ValueType energy)
+	{
+		if (length != state.length)
+			setLength(state, ring, capacity, length);
+
+		if (state.filled >= state.length)
+			state.sum = state.sum - getEntry(state, ring, capacity, state.length - 1);
+
+		ring[state.index] = energy;
+		state.index = (state.index + 1 == capacity) ? 0 : state.index + 1;
+		state.filled = juce::jmin(state.filled + 1, capacity);
+		state.sum = state.sum + energy;
+		state.fresh = state.fresh + energy;
+
+		if (++state.sinceFresh == state.length)
+		{
+			state.sum = state.fresh;
+			state.fresh = ValueType();
+			state.sinceFresh = 0;
+		}
+
+		return state.sum;
+	}
+}
@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+    Cascaded polyphase half-band FIR oversampling, one channel per Float4 lane.
+
+  ==============================================================================
+*/
+
+#include "Oversampler.h"
+#include "KaiserWindow.h"
+
+//==============================================================================
+void HalfBandFilter::init(int halfLength, int maxInputSize)
+{
+	jassert(halfLength <= MAX_HALF_LENGTH);
+
+	m_halfLength = halfLength;
+	m_maxInputSize = maxInputSize;
+
+	// Kaiser window with roughly 80 dB stopband attenuation
+	static const double beta = 8.0;
+	const double pi = juce::MathConstants<double>::pi;
+
+	double taps[MAX_HALF_LENGTH] = {};
+	double sum = 0.0;
+
+	for (int i = 0; i < halfLength; ++i)
+	{
+		const double n = 2.0 * i + 1.0;
+		const double ratio = n / (2.0 * halfLength);
+		const double window = KaiserWindow::get(ratio, beta);
+
+		taps[i] = std::sin(0.5 * pi * n) / (pi * n) * window;
+		sum += 2.0 * taps[i];
+	}
+
+	// Odd taps add up to 0.5 for unity gain at DC
+	for (int i = 0; i < halfLength; ++i)
+		m_coefficients[i] = (float)(0.5 * taps[i] / sum);
+}
+
+void HalfBandFilter::upsample(Float4* history, const Float4* in, Float4* out, int numSamples) const
+{
+	jassert(numSamples <= m_maxInputSize);
+
+	const int K = m_halfLength;
+	const int historyLength = 2 * K - 1;
+
+	std::copy(in, in + numSamples, history + historyLength);
+
+	for (int m = 0; m < numSamples; ++m)
+	{
+		// Window covers x[m - 2K + 1] ... x[m]. Even outputs are the odd taps
+		// applied symmetrically, odd outputs are the delayed input.
+		const Float4* x = history + m;
+		Float4 sum = Float4::zero();
+
+		for (int q = 0; q < K; ++q)
+			sum = sum + Float4::broadcast(2.0f * m_coefficients[K - 1 - q]) * (x[q] + x[historyLength - q]);
+
+		out[2 * m] = sum;
+		out[2 * m + 1] = x[K];
+	}
+
+	std::copy(history + numSamples, history + numSamples + historyLength, history);
+}
+
+void HalfBandFilter::downsample(Float4* history, const Float4* in, Float4* out, int numSamples) const
+{
+	jassert(numSamples <= m_maxInputSize);
+
+	const int K = m_halfLength;
+	const int historyLength = 4 * K - 2;
+	const Float4 half = Float4::broadcast(0.5f);
+
+	std::copy(in, in + 2 * numSamples, history + historyLength);
+
+	for (int m = 0; m < numSamples; ++m)
+	{
+		// Output is aligned with the even input sample, so the centre tap
+		// lands on an odd one and the odd taps on even ones
+		const Float4* v = history + historyLength + 2 * m;
+		Float4 sum = half * v[1 - 2 * K];
+
+		for (int r = 0; r < K; ++r)
+			sum = sum + Float4::broadcast(m_coefficients[K - 1 - r]) * (v[-2 * r] + v[2 + 2 * r - 4 * K]);
+
+		out[m] = sum;
+	}
+
+	std::copy(history + 2 * numSamples, history + 2 * numSamples + historyLength, history);
+}
+
+//==============================================================================
+// Later stages run above the audible band and can use shorter filters
+const int Oversampler::STAGE_HALF_LENGTHS[MAX_FACTOR_LOG2] = { 16, 8, 6 };
+
+void Oversampler::prepare(Arena& arena)
+{
+	for (int stage = 0; stage < MAX_FACTOR_LOG2; ++stage)
+	{
+		m_stages[stage].init(STAGE_HALF_LENGTHS[stage], MAX_BLOCK_SIZE << stage);
+		m_buffers[stage] = arena.allocate<Float4>(MAX_BLOCK_SIZE << (stage + 1));
+	}
+
+	setFactorLog2(m_factorLog2);
+}
+
+void Oversampler::allocateState(Arena& arena, State* state) const
+{
+	for (int stage = 0; stage < MAX_FACTOR_LOG2; ++stage)
+	{
+		Float4* upHistory = arena.allocate<Float4>(m_stages[stage].getUpHistorySize());
+		Float4* downHistory = arena.allocate<Float4>(m_stages[stage].getDownHistorySize());
+
+		if (state != nullptr)
+		{
+			state->upHistory[stage] = upHistory;
+			state->downHistory[stage] = downHistory;
+		}
+	}
+}
+
+void Oversampler::setFactorLog2(int factorLog2)
+{
+	m_factorLog2 = juce::jlimit(0, MAX_FACTOR_LOG2, factorLog2);
+
+	// Each stage delays by getDelay() on the way up and again on the way down,
+	// counted here in samples at the top rate
+	int delay = 0;
+
+	for (int stage = 0; stage < m_factorLog2; ++stage)
+		delay += 2 * m_stages[stage].getDelay() << (m_factorLog2 - stage - 1);
+
+	const int factor = getFactor();
+	m_paddingLength = (factor - delay % factor) % factor;
+	m_latency = (delay + m_paddingLength) / factor;
+
+	jassert(m_latency <= MAX_LATENCY);
+}
+
+void Oversampler::reset(State& state) const
+{
+	for (int stage = 0; stage < MAX_FACTOR_LOG2; ++stage)
+	{
+		std::fill(state.upHistory[stage], state.upHistory[stage] + m_stages[stage].getUpHistorySize(), Float4::zero());
+		std::fill(state.downHistory[stage], state.downHistory[stage] + m_stages[stage].getDownHistorySize(), Float4::zero());
+	}
+
+	std::fill(std::begin(state.padding), std::end(state.padding), Float4::zero());
+	std::fill(std::begin(state.dryDelay), std::end(state.dryDelay), Float4::zero());
+	state.paddingIndex = 0;
+	state.dryDelayIndex = 0;
+}
+
+Float4* Oversampler::upsample(State& state, const Float4* in, int numSamples)
+{
+	jassert(m_factorLog2 > 0 && numSamples <= MAX_BLOCK_SIZE);
+
+	const Float4* source = in;
+
+	for (int stage = 0; stage < m_factorLog2; ++stage)
+	{
+		m_stages[stage].upsample(state.upHistory[stage], source, m_buffers[stage], numSamples << stage);
+		source = m_buffers[stage];
+	}
+
+	return m_buffers[m_factorLog2 - 1];
+}
+
+void Oversampler::downsample(State& state, Float4* out, int numSamples)
+{
+	jassert(m_factorLog2 > 0 && numSamples <= MAX_BLOCK_SIZE);
+
+	Float4* top = m_buffers[m_factorLog2 - 1];
+
+	if (m_paddingLength > 0)
+	{
+		for (int i = 0; i < numSamples << m_factorLog2; ++i)
+		{
+			const Float4 delayed = state.padding[state.paddingIndex];
+			state.padding[state.paddingIndex] = top[i];
+			top[i] = delayed;
+
+			if (++state.paddingIndex == m_paddingLength)
+				state.paddingIndex = 0;
+		}
+	}
+
+	for (int stage = m_factorLog2 - 1; stage >= 0; --stage)
+	{
+		Float4* destination = stage > 0 ? m_buffers[stage - 1] : out;
+		m_stages[stage].downsample(state.downHistory[stage], m_buffers[stage], destination, numSamples << stage);
+	}
+}
+
+void Oversampler::delayDry(State& state, const Float4* in, Float4* out, int numSamples) const
+{
+	if (m_latency == 0)
+	{
+		std::copy(in, in + numSamples, out);
+		return;
+	}
+
+	for (int i = 0; i < numSamples; ++i)
+	{
+		const Float4 sample = in[i];
+		out[i] = state.dryDelay[state.dryDelayIndex];
+		state.dryDelay[state.dryDelayIndex] = sample;
+
+		if (++state.dryDelayIndex == m_latency)
+			state.dryDelayIndex = 0;
+	}
+}
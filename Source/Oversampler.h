@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    Cascaded polyphase half-band FIR oversampling, one channel per Float4 lane.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SIMD.h"
+#include "Arena.h"
+
+//==============================================================================
+// Kaiser windowed half-band FIR, 4 * halfLength - 1 taps. Every other tap is
+// zero and the centre tap is 0.5, so only halfLength coefficient pairs are
+// stored. Delay is 2 * halfLength - 1 samples at the higher rate.
+//
+// The filter only holds coefficients; the history of each channel group is
+// passed in, so one filter serves any number of groups.
+class HalfBandFilter
+{
+public:
+	HalfBandFilter() {};
+
+	static const int MAX_HALF_LENGTH = 16;
+
+	void init(int halfLength, int maxInputSize);
+
+	int getUpHistorySize() const { return 2 * m_halfLength - 1 + m_maxInputSize; }
+	int getDownHistorySize() const { return 4 * m_halfLength - 2 + 2 * m_maxInputSize; }
+
+	// Writes 2 * numSamples frames
+	void upsample(Float4* history, const Float4* in, Float4* out, int numSamples) const;
+
+	// Reads 2 * numSamples frames
+	void downsample(Float4* history, const Float4* in, Float4* out, int numSamples) const;
+
+	int getDelay() const { return 2 * m_halfLength - 1; }
+
+private:
+	int m_halfLength = 0;
+	int m_maxInputSize = 0;
+
+	// Odd taps h[1], h[3] ... h[2 * halfLength - 1]
+	float m_coefficients[MAX_HALF_LENGTH] = {};
+};
+
+//==============================================================================
+// 2x, 4x or 8x oversampling of up to MAX_BLOCK_SIZE base rate frames per call.
+// The round trip delay is padded to a whole number of base rate samples so the
+// dry signal can be aligned with delayDry().
+class Oversampler
+{
+public:
+	Oversampler() {};
+
+	static const int MAX_FACTOR_LOG2 = 3;
+	static const int MAX_BLOCK_SIZE = 64;
+	static const int MAX_LATENCY = 64;
+
+	// Filter histories and delays of one channel group
+	struct State
+	{
+		Float4* upHistory[MAX_FACTOR_LOG2] = {};
+		Float4* downHistory[MAX_FACTOR_LOG2] = {};
+
+		// Pads the round trip at the top rate
+		Float4 padding[1 << MAX_FACTOR_LOG2] = {};
+		int paddingIndex = 0;
+
+		Float4 dryDelay[MAX_LATENCY] = {};
+		int dryDelayIndex = 0;
+	};
+
+	// Designs every stage and takes the shared stage buffers from the arena,
+	// call from prepareToPlay
+	void prepare(Arena& arena);
+
+	// Takes the histories of one group from the arena. In the arena's
+	// measuring pass state is nullptr.
+	void allocateState(Arena& arena, State* state) const;
+
+	// 0 disables oversampling. Does not allocate; every State must be reset.
+	void setFactorLog2(int factorLog2);
+	void reset(State& state) const;
+
+	int getFactorLog2() const { return m_factorLog2; }
+	int getFactor() const { return 1 << m_factorLog2; }
+
+	// Round trip delay in base rate samples
+	int getLatency() const { return m_latency; }
+
+	// Returns numSamples * getFactor() frames, which are processed in place
+	// and then passed back with downsample(). The buffers are shared by all
+	// groups, so each group has to be downsampled before the next one starts.
+	Float4* upsample(State& state, const Float4* in, int numSamples);
+	void downsample(State& state, Float4* out, int numSamples);
+
+	void delayDry(State& state, const Float4* in, Float4* out, int numSamples) const;
+
+private:
+	static const int STAGE_HALF_LENGTHS[MAX_FACTOR_LOG2];
+
+	int m_factorLog2 = 0;
+	int m_latency = 0;
+	int m_paddingLength = 0;
+
+	HalfBandFilter m_stages[MAX_FACTOR_LOG2];
+	Float4* m_buffers[MAX_FACTOR_LOG2] = {};
+};
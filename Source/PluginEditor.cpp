@@ -9,9 +9,224 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+//==============================================================================
+TelemetryComponent::TelemetryComponent(Telemetry& telemetry, ZazzLookAndFeel& lookAndFeel) : m_telemetry(telemetry), m_lookAndFeel(lookAndFeel)
+{
+	m_resetButton.setLookAndFeel(&m_lookAndFeel);
+	m_resetButton.setColour(juce::TextButton::buttonColourId, m_lookAndFeel.m_medium);
+	m_resetButton.onClick = [this] { m_telemetry.resetStatistics(); repaint(); };
+	addAndMakeVisible(m_resetButton);
+
+	m_exportButton.setLookAndFeel(&m_lookAndFeel);
+	m_exportButton.setColour(juce::TextButton::buttonColourId, m_lookAndFeel.m_medium);
+	m_exportButton.onClick = [this] { exportStatistics(); };
+	addAndMakeVisible(m_exportButton);
+
+	startTimerHz(REFRESH_RATE);
+}
+
+TelemetryComponent::~TelemetryComponent()
+{
+	m_resetButton.setLookAndFeel(nullptr);
+	m_exportButton.setLookAndFeel(nullptr);
+}
+
+void TelemetryComponent::timerCallback()
+{
+	m_telemetry.collect();
+	repaint();
+}
+
+void TelemetryComponent::paint(juce::Graphics& g)
+{
+	g.fillAll(m_lookAndFeel.m_dark);
+
+	// CPU meter, share of the host's time budget per block
+	const float load = m_telemetry.getLoad();
+	const float worstLoad = m_telemetry.getWorstLoad();
+
+	auto meter = m_meterArea.toFloat();
+	g.setColour(m_lookAndFeel.m_medium);
+	g.fillRect(meter.withWidth(meter.getWidth() * juce::jmin(load, 1.0f)));
+
+	juce::String text = "CPU " + juce::String(100.0f * load, 1) + " %  peak " + juce::String(100.0f * worstLoad, 1) + " %";
+
+	if (m_telemetry.isIdle())
+		text += "  idle";
+
+	if (m_telemetry.getDroppedBlocks() > 0)
+		text += "  dropped " + juce::String(m_telemetry.getDroppedBlocks());
+
+	g.setColour(juce::Colours::white);
+	g.setFont(juce::Font(0.6f * meter.getHeight()));
+	g.drawText(text, m_meterArea.reduced(4, 0), juce::Justification::centredLeft);
+
+	// Histogram of block costs in steps of 5 % of the budget
+	const int maximum = m_telemetry.getHistogramMaximum();
+
+	if (maximum > 0)
+	{
+		const auto area = m_histogramArea.toFloat();
+		const float barWidth = area.getWidth() / Telemetry::HISTOGRAM_BINS;
+
+		g.setColour(m_lookAndFeel.m_light);
+
+		for (int bin = 0; bin < Telemetry::HISTOGRAM_BINS; ++bin)
+		{
+			const float height = area.getHeight() * (float)m_telemetry.getHistogramBin(bin) / (float)maximum;
+			g.fillRect(area.getX() + bin * barWidth, area.getBottom() - height, barWidth - 1.0f, height);
+		}
+	}
+}
+
+void TelemetryComponent::resized()
+{
+	auto area = getLocalBounds().reduced(2);
+	const int buttonWidth = area.getHeight() * 2;
+
+	m_exportButton.setBounds(area.removeFromRight(buttonWidth));
+	area.removeFromRight(2);
+	m_resetButton.setBounds(area.removeFromRight(buttonWidth));
+	area.removeFromRight(2);
+
+	m_meterArea = area.removeFromLeft(area.getWidth() / 2);
+	area.removeFromLeft(2);
+	m_histogramArea = area;
+}
+
+void TelemetryComponent::exportStatistics()
+{
+	const auto defaultFile = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("DistortionTelemetry.csv");
+	m_fileChooser = std::make_unique<juce::FileChooser>("Export telemetry", defaultFile, "*.csv;*.json");
+
+	const int flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles | juce::FileBrowserComponent::warnAboutOverwriting;
+
+	m_fileChooser->launchAsync(flags, [this](const juce::FileChooser& chooser)
+	{
+		const auto file = chooser.getResult();
+
+		if (file == juce::File())
+			return;
+
+		m_telemetry.collect();
+		file.replaceWithText(file.hasFileExtension("json") ? m_telemetry.exportJson() : m_telemetry.exportCsv());
+	});
+}
+
+//==============================================================================
+TransferCurveComponent::TransferCurveComponent(DisplayFeed& displayFeed, ZazzLookAndFeel& lookAndFeel) : m_displayFeed(displayFeed), m_lookAndFeel(lookAndFeel)
+{
+	setOpaque(true);
+	startTimerHz(FRAME_RATE);
+}
+
+void TransferCurveComponent::timerCallback()
+{
+	DisplayFrame frame;
+	const bool received = m_displayFeed.collect(frame);
+
+	// Peak hold with a constant fall, snapped to zero below the meter range
+	const float fall = juce::Decibels::decibelsToGain(-METER_FALL_DB);
+	const float floor = juce::Decibels::decibelsToGain(METER_FLOOR_DB);
+
+	float inputLevel = juce::jmax(received ? frame.inputLevel : 0.0f, m_inputLevel * fall);
+	float outputLevel = juce::jmax(received ? frame.outputLevel : 0.0f, m_outputLevel * fall);
+	inputLevel = (inputLevel < floor) ? 0.0f : inputLevel;
+	outputLevel = (outputLevel < floor) ? 0.0f : outputLevel;
+
+	const bool curveChanged = received && (frame.exponent != m_frame.exponent || frame.wetGain != m_frame.wetGain || frame.dryGain != m_frame.dryGain);
+
+	if (curveChanged)
+	{
+		m_frame = frame;
+		updateCurve();
+	}
+
+	if (curveChanged || inputLevel != m_inputLevel || outputLevel != m_outputLevel)
+	{
+		m_inputLevel = inputLevel;
+		m_outputLevel = outputLevel;
+		repaint();
+	}
+}
+
+void TransferCurveComponent::updateCurve()
+{
+	m_curve.clear();
+
+	for (int i = 0; i <= CURVE_POINTS; ++i)
+	{
+		const float in = 2.0f * (float)i / (float)CURVE_POINTS - 1.0f;
+		const float shaped = std::copysign(std::pow(std::abs(in), m_frame.exponent), in);
+		const float out = juce::jlimit(-1.0f, 1.0f, m_frame.wetGain * shaped + m_frame.dryGain * in);
+
+		const float x = m_curveArea.getX() + 0.5f * (in + 1.0f) * m_curveArea.getWidth();
+		const float y = m_curveArea.getY() + 0.5f * (1.0f - out) * m_curveArea.getHeight();
+
+		if (i == 0)
+			m_curve.startNewSubPath(x, y);
+		else
+			m_curve.lineTo(x, y);
+	}
+}
+
+float TransferCurveComponent::levelToProportion(float level) const
+{
+	const float db = juce::Decibels::gainToDecibels(level, METER_FLOOR_DB);
+	return juce::jlimit(0.0f, 1.0f, (db - METER_FLOOR_DB) / -METER_FLOOR_DB);
+}
+
+void TransferCurveComponent::paint(juce::Graphics& g)
+{
+	g.drawImage(m_background, getLocalBounds().toFloat());
+
+	// Curve
+	g.setColour(juce::Colours::white);
+	g.strokePath(m_curve, juce::PathStrokeType(2.0f));
+
+	// Meters
+	g.setColour(m_lookAndFeel.m_light);
+	g.fillRect(m_inputMeterArea.withTop(m_inputMeterArea.getBottom() - m_inputMeterArea.getHeight() * levelToProportion(m_inputLevel)));
+	g.fillRect(m_outputMeterArea.withTop(m_outputMeterArea.getBottom() - m_outputMeterArea.getHeight() * levelToProportion(m_outputLevel)));
+}
+
+void TransferCurveComponent::resized()
+{
+	auto area = getLocalBounds().toFloat().reduced(8.0f);
+	const float meterWidth = juce::jmax(2.0f, area.getWidth() * 0.05f);
+
+	m_outputMeterArea = area.removeFromRight(meterWidth);
+	area.removeFromRight(2.0f);
+	m_inputMeterArea = area.removeFromRight(meterWidth);
+	area.removeFromRight(6.0f);
+
+	const float size = juce::jmin(area.getWidth(), area.getHeight());
+	m_curveArea = area.withSizeKeepingCentre(size, size);
+
+	// Grid and meter tracks
+	const float scale = juce::Component::getApproximateScaleFactorForComponent(this);
+	m_background = juce::Image(juce::Image::ARGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)), juce::jmax(1, juce::roundToInt(getHeight() * scale)), true);
+
+	juce::Graphics g(m_background);
+	g.addTransform(juce::AffineTransform::scale(scale));
+	g.fillAll(juce::Colour::fromHSV(0.6f, 0.5f, 0.7f, 1.0f));
+
+	g.setColour(m_lookAndFeel.m_dark);
+	g.fillRect(m_curveArea);
+	g.fillRect(m_inputMeterArea);
+	g.fillRect(m_outputMeterArea);
+
+	g.setColour(m_lookAndFeel.m_medium);
+	g.drawLine(m_curveArea.getX(), m_curveArea.getCentreY(), m_curveArea.getRight(), m_curveArea.getCentreY());
+	g.drawLine(m_curveArea.getCentreX(), m_curveArea.getY(), m_curveArea.getCentreX(), m_curveArea.getBottom());
+	g.drawLine(m_curveArea.getX(), m_curveArea.getBottom(), m_curveArea.getRight(), m_curveArea.getY());
+
+	updateCurve();
+}
+
 //==============================================================================
 DistortionAudioProcessorEditor::DistortionAudioProcessorEditor (DistortionAudioProcessor& p, juce::AudioProcessorValueTreeState& vts)
-    : AudioProcessorEditor (&p), audioProcessor (p), valueTreeState(vts)
+    : AudioProcessorEditor (&p), audioProcessor (p), valueTreeState(vts), m_transferCurveComponent(p.getDisplayFeed(), zazzLookAndFeel), m_telemetryComponent(p.getTelemetry(), zazzLookAndFeel)
 {
 	juce::Colour light  = juce::Colour::fromHSV(0.6f, 0.5f, 0.6f, 1.0f);
 	juce::Colour medium = juce::Colour::fromHSV(0.6f, 0.5f, 0.5f, 1.0f);
@@ -33,19 +248,26 @@ DistortionAudioProcessorEditor::DistortionAudioProcessorEditor (DistortionAudioP
 		//Slider
 		slider.setLookAndFeel(&zazzLookAndFeel);
 		slider.setSliderStyle(juce::Slider::SliderStyle::RotaryHorizontalVerticalDrag);
+		slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 70, ZazzLookAndFeel::SLIDER_FONT_SIZE);
 		addAndMakeVisible(slider);
 		m_sliderAttachment[i].reset(new SliderAttachment(valueTreeState, DistortionAudioProcessor::paramsNames[i], slider));
 	}
 
+	// Transfer curve and telemetry
+	addAndMakeVisible(m_transferCurveComponent);
+	addAndMakeVisible(m_telemetryComponent);
+
 	// Canvas
+	setOpaque(true);
 	setResizable(true, true);
-	const float width = SLIDER_WIDTH * N_SLIDERS;
-	setSize(width, SLIDER_WIDTH);
+	const float width = SLIDER_WIDTH * N_SLIDERS + DISPLAY_WIDTH;
+	const float height = SLIDER_WIDTH + TELEMETRY_HEIGHT;
+	setSize(width, height);
 
 	if (auto* constrainer = getConstrainer())
 	{
-		constrainer->setFixedAspectRatio(N_SLIDERS);
-		constrainer->setSizeLimits(width * 0.7f, SLIDER_WIDTH * 0.7, width * 2.0f, SLIDER_WIDTH * 2.0f);
+		constrainer->setFixedAspectRatio(width / height);
+		constrainer->setSizeLimits(width * 0.7f, height * 0.7, width * 2.0f, height * 2.0f);
 	}
 }
 
@@ -56,20 +278,16 @@ DistortionAudioProcessorEditor::~DistortionAudioProcessorEditor()
 //==============================================================================
 void DistortionAudioProcessorEditor::paint (juce::Graphics& g)
 {
-	g.fillAll(juce::Colour::fromHSV(0.6f, 0.5f, 0.7f, 1.0f));
-
-	// Lines
-	g.setColour(juce::Colour::fromHSV(0.6f, 0.5f, 0.6f, 1.0f));
-	const int width = (int)(getWidth() / N_SLIDERS);
-	
-	g.drawVerticalLine(2 * width, 0, getHeight());
-	g.drawVerticalLine(4 * width, 0, getHeight());
+	g.drawImage(m_background, getLocalBounds().toFloat());
 }
 
 void DistortionAudioProcessorEditor::resized()
 {
-	const int width = (int)(getWidth() / N_SLIDERS);
-	const int height = getHeight();
+	const int telemetryHeight = (int)(getHeight() * TELEMETRY_HEIGHT / (SLIDER_WIDTH + TELEMETRY_HEIGHT));
+	m_telemetryComponent.setBounds(0, getHeight() - telemetryHeight, getWidth(), telemetryHeight);
+
+	const int width = (int)(getWidth() * SLIDER_WIDTH / (SLIDER_WIDTH * N_SLIDERS + DISPLAY_WIDTH));
+	const int height = getHeight() - telemetryHeight;
 	const int fonthHeight = (int)(height / FONT_DIVISOR);
 	const int labelOffset = (int)(SLIDER_WIDTH / FONT_DIVISOR) + 5;
 
@@ -87,4 +305,23 @@ void DistortionAudioProcessorEditor::resized()
 
 		m_labels[i].setFont(juce::Font(fonthHeight, juce::Font::bold));
 	}
+
+	m_transferCurveComponent.setBounds(N_SLIDERS * width, 0, getWidth() - N_SLIDERS * width, height);
+
+	// Cached layers, rendered at the display's pixel density
+	const float scale = juce::Component::getApproximateScaleFactorForComponent(this);
+	const auto knobArea = zazzLookAndFeel.getSliderLayout(m_sliders[0]).sliderBounds;
+	zazzLookAndFeel.prepareKnob(knobArea.getWidth(), knobArea.getHeight(), scale);
+
+	m_background = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)), juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+	juce::Graphics g(m_background);
+	g.addTransform(juce::AffineTransform::scale(scale));
+
+	g.fillAll(juce::Colour::fromHSV(0.6f, 0.5f, 0.7f, 1.0f));
+
+	// Lines
+	g.setColour(juce::Colour::fromHSV(0.6f, 0.5f, 0.6f, 1.0f));
+	g.drawVerticalLine(2 * width, 0, height);
+	g.drawVerticalLine(4 * width, 0, height);
+	g.drawVerticalLine(N_SLIDERS * width, 0, height);
 }
@@ -29,35 +29,49 @@ public:
 	int m_scale;
 	static const int FONT_SIZE = 15;
 	static const int SLIDER_FONT_SIZE = 20;
+	static constexpr float LINE_THICKNESS = 6.0f;
 	
-	void drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height, float sliderPos, const float rotaryStartAngle, const float rotaryEndAngle, juce::Slider& s) override
+	// Renders the knob outline for a rotary area of width x height, and the
+	// pointer shape, so drawRotarySlider only rotates and fills the pointer.
+	// Call from resized(), the scale is the display's pixel density.
+	void prepareKnob(int width, int height, float scale)
 	{
-		auto radius = ((float)juce::jmin(width / 2, height / 2) - 4.0f) * 0.9f;
+		m_knobWidth = width;
+		m_knobHeight = height;
+
+		const auto radius = getKnobRadius(width, height);
+		const auto centreX = (float)width * 0.5f;
+		const auto centreY = (float)height * 0.5f;
+
+		m_knobImage = juce::Image(juce::Image::ARGB, juce::jmax(1, juce::roundToInt(width * scale)), juce::jmax(1, juce::roundToInt(height * scale)), true);
+		juce::Graphics g(m_knobImage);
+		g.addTransform(juce::AffineTransform::scale(scale));
+
+		// outline
+		g.setColour(m_medium);
+		g.drawEllipse(centreX - radius, centreY - radius, radius * 2.0f, radius * 2.0f, LINE_THICKNESS);
+
+		// pointer, pointing up from the centre
+		m_pointer.clear();
+		m_pointer.addRectangle(-LINE_THICKNESS * 0.5f, -radius, LINE_THICKNESS, radius * 0.2f);
+	}
+
+	void drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height, float sliderPos, const float rotaryStartAngle, const float rotaryEndAngle, juce::Slider&) override
+	{
+		// Not prepared for this size yet
+		if (width != m_knobWidth || height != m_knobHeight)
+			prepareKnob(width, height, 1.0f);
+
 		auto centreX = (float)x + (float)width  * 0.5f;
 		auto centreY = (float)y + (float)height * 0.5f;
-		auto rx = centreX - radius;
-		auto ry = centreY - radius;
-		auto rw = radius * 2.0f;
 		auto angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
 
 		// outline
-		const float lineThickness = 6.0f;
-
-		g.setColour(m_medium);
-		g.drawEllipse(rx, ry, rw, rw, lineThickness);
-
-		juce::Path p;
-		auto pointerLength = radius * 0.2f;
-		auto pointerThickness = lineThickness;
-		p.addRectangle(-pointerThickness * 0.5f, -radius, pointerThickness, pointerLength);
-		p.applyTransform(juce::AffineTransform::rotation(angle).translated(centreX, centreY));
+		g.drawImage(m_knobImage, juce::Rectangle<int>(x, y, width, height).toFloat());
 
 		// pointer
 		g.setColour(m_medium);
-		g.fillPath(p);
-
-		// slider style
-		s.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 70, SLIDER_FONT_SIZE);
+		g.fillPath(m_pointer, juce::AffineTransform::rotation(angle).translated(centreX, centreY));
 	}
 
 	juce::Label *createSliderTextBox(juce::Slider &) override
@@ -75,6 +89,85 @@ public:
 		g.setColour(backgroundColour);
 		g.fillRect(buttonArea);
 	}
+
+private:
+	static float getKnobRadius(int width, int height)
+	{
+		return ((float)juce::jmin(width / 2, height / 2) - 4.0f) * 0.9f;
+	}
+
+	juce::Image m_knobImage;
+	juce::Path m_pointer;
+	int m_knobWidth = 0;
+	int m_knobHeight = 0;
+};
+
+//==============================================================================
+// CPU meter and block cost histogram from the processor's Telemetry, which
+// this component drains on the message thread
+class TelemetryComponent : public juce::Component, private juce::Timer
+{
+public:
+	TelemetryComponent(Telemetry& telemetry, ZazzLookAndFeel& lookAndFeel);
+	~TelemetryComponent() override;
+
+	static const int REFRESH_RATE = 10;
+
+	void paint(juce::Graphics&) override;
+	void resized() override;
+
+private:
+	void timerCallback() override;
+	void exportStatistics();
+
+	Telemetry& m_telemetry;
+	ZazzLookAndFeel& m_lookAndFeel;
+
+	juce::TextButton m_resetButton{ "Reset" };
+	juce::TextButton m_exportButton{ "Export" };
+	std::unique_ptr<juce::FileChooser> m_fileChooser;
+
+	juce::Rectangle<int> m_meterArea;
+	juce::Rectangle<int> m_histogramArea;
+};
+
+//==============================================================================
+// Transfer curve of the shaper and mix, with input and output peak meters.
+// Frames come from the processor's DisplayFeed. The grid is cached and the
+// curve is only rebuilt when its parameters change.
+class TransferCurveComponent : public juce::Component, private juce::Timer
+{
+public:
+	TransferCurveComponent(DisplayFeed& displayFeed, ZazzLookAndFeel& lookAndFeel);
+
+	static const int FRAME_RATE = 30;
+	static const int CURVE_POINTS = 64;
+
+	// Meter range and fall per frame, about 20 dB per second
+	static constexpr float METER_FLOOR_DB = -48.0f;
+	static constexpr float METER_FALL_DB = 20.0f / FRAME_RATE;
+
+	void paint(juce::Graphics&) override;
+	void resized() override;
+
+private:
+	void timerCallback() override;
+	void updateCurve();
+	float levelToProportion(float level) const;
+
+	DisplayFeed& m_displayFeed;
+	ZazzLookAndFeel& m_lookAndFeel;
+
+	DisplayFrame m_frame;
+	float m_inputLevel = 0.0f;
+	float m_outputLevel = 0.0f;
+
+	juce::Image m_background;
+	juce::Path m_curve;
+
+	juce::Rectangle<float> m_curveArea;
+	juce::Rectangle<float> m_inputMeterArea;
+	juce::Rectangle<float> m_outputMeterArea;
 };
 
 //==============================================================================
@@ -89,6 +182,8 @@ public:
 	// GUI setup
 	static const int N_SLIDERS = 6;
 	static const int SLIDER_WIDTH = 140;
+	static const int DISPLAY_WIDTH = 140;
+	static const int TELEMETRY_HEIGHT = 30;
 
 	static const int FONT_DIVISOR = 9;
 
@@ -109,5 +204,11 @@ private:
 	juce::Slider m_sliders[N_SLIDERS] = {};
 	std::unique_ptr<SliderAttachment> m_sliderAttachment[N_SLIDERS] = {};
 
+	TransferCurveComponent m_transferCurveComponent;
+	TelemetryComponent m_telemetryComponent;
+
+	// Background and divider lines, rendered in resized()
+	juce::Image m_background;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DistortionAudioProcessorEditor)
 };
@@ -10,49 +10,81 @@
 #include "PluginEditor.h"
 
 //==============================================================================
-EnvelopeFollower::EnvelopeFollower()
+template <typename SampleType>
+EnvelopeFollower<SampleType>::EnvelopeFollower()
 {
 }
 
-void EnvelopeFollower::setCoef(float attackTimeMs, float releaseTimeMs)
+template <typename SampleType>
+void EnvelopeFollower<SampleType>::setCoef(float attackTimeMs, float releaseTimeMs)
 {
-	m_AttackCoef = exp(-1000.0f / (attackTimeMs * m_SampleRate));
-	m_ReleaseCoef = exp(-1000.0f / (releaseTimeMs * m_SampleRate));
+	m_AttackCoef = std::exp(SampleType(-1000) / (SampleType(attackTimeMs) * m_SampleRate));
+	m_ReleaseCoef = std::exp(SampleType(-1000) / (SampleType(releaseTimeMs) * m_SampleRate));
 }
 
-float EnvelopeFollower::process(float in)
+template <typename SampleType>
+SampleType EnvelopeFollower<SampleType>::process(SampleType in)
 {
-	const float inAbs = fabs(in);
-	m_Out1Last = fmaxf(inAbs, m_ReleaseCoef * m_Out1Last + (1.0f - m_ReleaseCoef) * inAbs);
+	const SampleType inAbs = std::abs(in);
+	m_Out1Last = std::fmax(inAbs, m_ReleaseCoef * m_Out1Last + (SampleType(1) - m_ReleaseCoef) * inAbs);
 	return m_OutLast = m_AttackCoef * (m_OutLast - m_Out1Last) + m_Out1Last;
 }
 
+template class EnvelopeFollower<float>;
+template class EnvelopeFollower<double>;
+
 //==============================================================================
 
-void BiquadLowPassFilter::set(float frequency, float Q)
+template <typename SampleType>
+void BiquadLowPassFilter<SampleType>::set(float frequency, float Q)
 {
-	float frequencyLimited = fminf(frequency, 0.5f * (float)m_SampleRate);
-	float norm;
-	float K = tan(3.141593f * frequencyLimited / m_SampleRate);
+	if (frequency == m_frequency && Q == m_Q)
+		return;
+
+	m_frequency = frequency;
+	m_Q = Q;
+
+	const SampleType frequencyLimited = std::fmin(SampleType(frequency), SampleType(0.5) * m_SampleRate);
+	const SampleType q = Q;
+	SampleType norm;
+	SampleType K = std::tan(SampleType(3.141593) * frequencyLimited / m_SampleRate);
 
-	norm = 1 / (1 + K / Q + K * K);
+	norm = 1 / (1 + K / q + K * K);
 	a0 = K * K * norm;
 	a1 = 2 * a0;
 	a2 = a0;
 	b1 = 2 * (K * K - 1) * norm;
-	b2 = (1 - K / Q + K * K) * norm;
+	b2 = (1 - K / q + K * K) * norm;
 }
 
-float BiquadLowPassFilter::process(float in)
+template <typename SampleType>
+SampleType BiquadLowPassFilter<SampleType>::process(SampleType in)
 {
-	float out = in * a0 + z1;
+	SampleType out = in * a0 + z1;
 	z1 = in * a1 + z2 - b1 * out;
 	z2 = in * a2 - b2 * out;
 	return out;
 }
+
+template class BiquadLowPassFilter<float>;
+template class BiquadLowPassFilter<double>;
 //==============================================================================
 
 const std::string DistortionAudioProcessor::paramsNames[] = { "Drive", "Dynamics", "Cutoff", "Resonance", "Mix", "Volume" };
+const std::string DistortionAudioProcessor::settingsNames[] = { "Shaper", "Oversampling", "Limiter", "Lookahead", "Filter", "Cutoff Mod", "Detector", "Window" };
+const std::string DistortionAudioProcessor::bypassName = "Bypass";
+const std::string DistortionAudioProcessor::multibandNames[] = { "Bands", "Crossover 1", "Crossover 2", "Crossover 3" };
+const std::string DistortionAudioProcessor::bandParamsNames[] = { "Drive 1", "Dynamics 1", "Mix 1", "Drive 2", "Dynamics 2", "Mix 2",
+                                                                  "Drive 3", "Dynamics 3", "Mix 3", "Drive 4", "Dynamics 4", "Mix 4" };
+
+// Every parameter but the bypass is in the snapshots and the binary state
+static_assert(juce::numElementsInArray(DistortionAudioProcessor::paramsNames) + juce::numElementsInArray(DistortionAudioProcessor::settingsNames)
+              + juce::numElementsInArray(DistortionAudioProcessor::multibandNames) + juce::numElementsInArray(DistortionAudioProcessor::bandParamsNames) == ParameterSnapshot::SIZE,
+              "ParameterSnapshot::SIZE does not match the parameter names");
+
+// -120 dB
+const float DistortionAudioProcessor::IDLE_THRESHOLD = 1.0e-6f;
+const float DistortionAudioProcessor::IDLE_HOLD_SECONDS = 0.05f;
 
 //==============================================================================
 DistortionAudioProcessor::DistortionAudioProcessor()
@@ -73,6 +105,42 @@ DistortionAudioProcessor::DistortionAudioProcessor()
 	resonanceParameter = apvts.getRawParameterValue(paramsNames[3]);
 	mixParameter    = apvts.getRawParameterValue(paramsNames[4]);
 	volumeParameter = apvts.getRawParameterValue(paramsNames[5]);;
+
+	shaperParameter = apvts.getRawParameterValue(settingsNames[0]);
+	oversamplingParameter = apvts.getRawParameterValue(settingsNames[1]);
+	limiterParameter = apvts.getRawParameterValue(settingsNames[2]);
+	lookaheadParameter = apvts.getRawParameterValue(settingsNames[3]);
+	filterParameter = apvts.getRawParameterValue(settingsNames[4]);
+	cutoffModParameter = apvts.getRawParameterValue(settingsNames[5]);
+	detectorParameter = apvts.getRawParameterValue(settingsNames[6]);
+	windowParameter = apvts.getRawParameterValue(settingsNames[7]);
+	bypassParameter = apvts.getRawParameterValue(bypassName);
+
+	bandsParameter = apvts.getRawParameterValue(multibandNames[0]);
+
+	for (int split = 0; split < Crossover::MAX_SPLITS; ++split)
+		crossoverParameters[split] = apvts.getRawParameterValue(multibandNames[split + 1]);
+
+	for (int i = 0; i < Crossover::MAX_BANDS * N_BAND_PARAMS; ++i)
+		bandParameters[i] = apvts.getRawParameterValue(bandParamsNames[i]);
+
+	juce::StringArray parameterIds;
+
+	for (const auto& name : paramsNames)
+		parameterIds.add(name);
+
+	for (const auto& name : settingsNames)
+		parameterIds.add(name);
+
+	for (const auto& name : multibandNames)
+		parameterIds.add(name);
+
+	for (const auto& name : bandParamsNames)
+		parameterIds.add(name);
+
+	m_presetBank.init(apvts, parameterIds);
+
+	startTimerHz(LATENCY_TIMER_HZ);
 }
 
 DistortionAudioProcessor::~DistortionAudioProcessor()
@@ -119,54 +187,300 @@ double DistortionAudioProcessor::getTailLengthSeconds() const
 
 int DistortionAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+	return m_presetBank.getNumPresets();
 }
 
 int DistortionAudioProcessor::getCurrentProgram()
 {
-    return 0;
+	return m_currentProgram;
 }
 
 void DistortionAudioProcessor::setCurrentProgram (int index)
 {
+	if (index < 0 || index >= m_presetBank.getNumPresets())
+		return;
+
+	m_currentProgram = index;
+	m_presetBank.apply(index);
 }
 
 const juce::String DistortionAudioProcessor::getProgramName (int index)
 {
-    return {};
+	if (index < 0 || index >= m_presetBank.getNumPresets())
+		return {};
+
+	return m_presetBank.getName(index);
 }
 
 void DistortionAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+	if (index >= 0 && index < m_presetBank.getNumPresets())
+		m_presetBank.setName(index, newName);
 }
 
 //==============================================================================
 void DistortionAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+	RealtimeAudit::checkBoundary("prepareToPlay");
+
 	const int sr = (int)sampleRate;
-	m_lowPassFilter[0].init(sr);
-	m_lowPassFilter[1].init(sr);
+	m_sampleRate = sr;
+	m_maxBlock = juce::jmax(1, samplesPerBlock);
 
-	m_inputEnvelope[0].init(sr);
-	m_inputEnvelope[1].init(sr);
+	// Pick kernel by CPU features, the SIMD kernel is float only
+	const bool simd = m_preferredKernel == KernelType::simd && SIMDKernel::isSupported() && !isUsingDoublePrecision();
+	m_kernelType = simd ? KernelType::simd : KernelType::scalar;
 
-	m_outputEnvelope[0].init(sr);
-	m_outputEnvelope[1].init(sr);
+	const int channels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
 
+	// Offline renders go for quality and spread the channel groups over the
+	// worker pool. This holds until the next prepareToPlay, so a host going
+	// back to realtime without one hears no latency change or reset.
+	m_offline = isNonRealtime();
+	m_threads = m_offline ? juce::jlimit(1, WorkerPool::MAX_THREADS, juce::jmin(m_offlineThreads, channels)) : 1;
+	m_groupWidth = juce::jlimit(1, Float4::size, (channels + m_threads - 1) / m_threads);
+	m_workerPool.prepare(m_threads - 1);
+
+	// Detector rings hold the longest window in gain intervals
+	m_kernelParameters.windowCapacity = (int)std::ceil(LoudnessWindow::MAX_MILLISECONDS * 0.001 * sampleRate / m_gainInterval);
+	KWeighting::design(sampleRate, m_kernelParameters.shelf, m_kernelParameters.highPass);
+
+	// Measure first, then allocate once and hand out the same layout again
+
+	m_arena.beginMeasure();
+	allocateChannelState(channels);
+	m_arena.allocateMemory(m_arena.getUsedBytes());
+	allocateChannelState(channels);
+
+	// Envelope followers run once per gain interval, so their times are
+	// divided by it to keep the same response in milliseconds
 	static const float attack = 1.0f;
 	static const float release = 10.0f;
+	const float interval = (float)m_gainInterval;
+
+	forEachScalarState([this, sr, interval](auto& state)
+	{
+		for (int channel = 0; channel < m_channels && state.lowPassFilter != nullptr; ++channel)
+		{
+			state.lowPassFilter[channel].init(sr);
+			state.inputEnvelope[channel].init(sr);
+			state.outputEnvelope[channel].init(sr);
+			state.inputEnvelope[channel].setCoef(attack / interval, release / interval);
+			state.outputEnvelope[channel].setCoef(attack / interval, release / interval);
+		}
+	});
+
+	// SIMD kernel shares the envelope coefficients across lanes
+	EnvelopeFollower<float> envelope;
+	envelope.init(sr);
+	envelope.setCoef(attack / interval, release / interval);
+	m_kernelParameters.gainInterval = m_gainInterval;
+	m_kernelParameters.attackCoef = envelope.getAttackCoef();
+	m_kernelParameters.releaseCoef = envelope.getReleaseCoef();
+
+	m_crossover.init(sr);
+	m_bands = 1;
+	m_tables = &m_sharedTables.prepare();
+	m_modulatedFilter = filterParameter->load() > 0.5f;
+	m_limiter.set(limiterParameter->load() > 0.5f, lookaheadParameter->load());
+	updateOversampling(getOversampling());
+
+	m_telemetry.prepare(sampleRate);
+
+	m_idle.store(false, std::memory_order_relaxed);
+	m_silentSamples = 0;
+
+	// Starts in the host's bypass state without a fade
+	m_bypass.reset(bypassParameter->load() > 0.5f);
+	m_bypassedSamples = 0;
+
+	// Parameter smoothing
+	static const double smoothingTime = 0.02;
+
+	m_driveSmoother.reset(sampleRate, smoothingTime);
+	m_dynamicsSmoother.reset(sampleRate, smoothingTime);
+	m_frequencySmoother.reset(sampleRate, smoothingTime);
+	m_resonanceSmoother.reset(sampleRate, smoothingTime);
+	m_mixSmoother.reset(sampleRate, smoothingTime);
+	m_volumeSmoother.reset(sampleRate, smoothingTime);
+
+	m_driveSmoother.setCurrentAndTargetValue(driveParameter->load());
+	m_dynamicsSmoother.setCurrentAndTargetValue(dynamicsParameter->load());
+	m_frequencySmoother.setCurrentAndTargetValue(frequencyParameter->load());
+	m_resonanceSmoother.setCurrentAndTargetValue(resonanceParameter->load() * 4.0f);
+	m_mixSmoother.setCurrentAndTargetValue(mixParameter->load());
+	m_volumeDecibels = volumeParameter->load();
+	m_volumeSmoother.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(m_volumeDecibels));
+
+	m_controlPhase = 0;
+	m_cutoffFrequency = 0.0f;
+
+	for (int split = 0; split < Crossover::MAX_SPLITS; ++split)
+	{
+		m_crossoverSmoothers[split].reset(sampleRate, smoothingTime);
+		m_crossoverSmoothers[split].setCurrentAndTargetValue(crossoverParameters[split]->load());
+	}
+
+	for (int i = 0; i < Crossover::MAX_BANDS * N_BAND_PARAMS; ++i)
+	{
+		m_bandSmoothers[i].reset(sampleRate, smoothingTime);
+		m_bandSmoothers[i].setCurrentAndTargetValue(bandParameters[i]->load());
+	}
+
+	reportLatency();
+}
+
+void DistortionAudioProcessor::allocateChannelState(int channels)
+{
+	m_channels = channels;
+	m_channelGroups = (channels + m_groupWidth - 1) / m_groupWidth;
+	std::get<float**>(m_subBlockChannels) = m_arena.allocate<float*>(channels);
+	std::get<double**>(m_subBlockChannels) = m_arena.allocate<double*>(channels);
+
+	std::get<ScalarKernelState<float>>(m_scalarState) = ScalarKernelState<float>();
+	std::get<ScalarKernelState<double>>(m_scalarState) = ScalarKernelState<double>();
+
+	// Limiter runs after either kernel, the bypass delay matches both
+	m_limiter.prepare(m_arena, channels, m_sampleRate, isUsingDoublePrecision());
+	m_bypass.prepare(m_arena, channels, m_sampleRate, m_maxBlock, Oversampler::MAX_LATENCY + m_limiter.getMaxLatency(), isUsingDoublePrecision());
+
+	if (m_kernelType == KernelType::scalar)
+	{
+		if (isUsingDoublePrecision())
+			allocateScalarState(std::get<ScalarKernelState<double>>(m_scalarState), channels);
+		else
+			allocateScalarState(std::get<ScalarKernelState<float>>(m_scalarState), channels);
+
+		m_channelGroupState = nullptr;
+		m_detectorHistory = nullptr;
+		m_oversamplerState = nullptr;
+		m_crossoverState = nullptr;
+		m_bandState = nullptr;
+		return;
+	}
+
+	// Detector rings of every group, then of every channel for the bands
+	const int ringsLength = 2 * m_kernelParameters.windowCapacity;
+	m_channelGroupState = m_arena.allocate<ChannelGroupState>(m_channelGroups);
+	m_detectorHistory = m_arena.allocate<Float4>((m_channelGroups + channels) * ringsLength);
+	m_oversamplerState = m_arena.allocate<Oversampler::State>(m_channelGroups);
+	m_crossoverState = m_arena.allocate<Crossover::State>(m_channelGroups);
+	m_bandState = m_arena.allocate<ChannelGroupState>(channels);
+
+	for (int group = 0; group < m_channelGroups && m_channelGroupState != nullptr; ++group)
+		m_channelGroupState[group].history = m_detectorHistory + group * ringsLength;
+
+	for (int channel = 0; channel < channels && m_bandState != nullptr; ++channel)
+		m_bandState[channel].history = m_detectorHistory + (m_channelGroups + channel) * ringsLength;
+
+	// Stage buffers of every thread, then the filter histories of every group
+	for (int thread = 0; thread < m_threads; ++thread)
+		m_oversamplers[thread].prepare(m_arena);
+
+	for (int group = 0; group < m_channelGroups; ++group)
+		m_oversamplers[0].allocateState(m_arena, m_oversamplerState != nullptr ? m_oversamplerState + group : nullptr);
+}
+
+template <typename SampleType>
+void DistortionAudioProcessor::allocateScalarState(ScalarKernelState<SampleType>& state, int channels)
+{
+	state.lowPassFilter = m_arena.allocate<BiquadLowPassFilter<SampleType>>(channels);
+	state.inputEnvelope = m_arena.allocate<EnvelopeFollower<SampleType>>(channels);
+	state.outputEnvelope = m_arena.allocate<EnvelopeFollower<SampleType>>(channels);
+	state.gainState = m_arena.allocate<GainComputerState<SampleType>>(channels);
+	state.modulatedFilter = m_arena.allocate<ModulatedFilterState<SampleType>>(channels);
+	state.shaperHistory = m_arena.allocate<AntiderivativeHistory<SampleType>>(channels);
+	state.detector = m_arena.allocate<DetectorState<SampleType>>(channels);
+	state.detectorHistory = m_arena.allocate<SampleType>(channels * 2 * m_kernelParameters.windowCapacity);
+}
+
+void DistortionAudioProcessor::resetChannelState()
+{
+	// Coefficients are recalculated with the next sample
+	m_controlPhase = 0;
+	m_limiter.reset();
+
+	if (m_kernelType == KernelType::simd)
+	{
+		for (int group = 0; group < m_channelGroups; ++group)
+		{
+			m_channelGroupState[group].reset();
+			m_oversamplers[0].reset(m_oversamplerState[group]);
+			m_crossoverState[group].reset();
+		}
+
+		for (int channel = 0; channel < m_channels; ++channel)
+			m_bandState[channel].reset();
+
+		return;
+	}
+
+	forEachScalarState([this](auto& state)
+	{
+		for (int channel = 0; channel < m_channels && state.lowPassFilter != nullptr; ++channel)
+		{
+			state.lowPassFilter[channel].reset();
+			state.inputEnvelope[channel].reset();
+			state.outputEnvelope[channel].reset();
+			state.gainState[channel] = {};
+			state.modulatedFilter[channel] = {};
+			state.shaperHistory[channel] = {};
+			state.detector[channel] = {};
+		}
+	});
+}
+
+int DistortionAudioProcessor::getOversampling() const
+{
+	const int oversampling = (int)oversamplingParameter->load();
+	return m_offline ? juce::jmax(oversampling, OFFLINE_OVERSAMPLING) : oversampling;
+}
 
-	m_inputEnvelope[0].setCoef(attack, release);
-	m_inputEnvelope[1].setCoef(attack, release);
+void DistortionAudioProcessor::updateOversampling(int factorLog2)
+{
+	// Oversampling is only implemented by the SIMD kernel
+	for (int thread = 0; thread < m_threads; ++thread)
+		m_oversamplers[thread].setFactorLog2(m_kernelType == KernelType::simd ? factorLog2 : 0);
+
+	m_kernelFilter.init(m_sampleRate * m_oversamplers[0].getFactor());
+	resetChannelState();
+	updateLatency();
+}
+
+void DistortionAudioProcessor::updateLatency()
+{
+	m_pendingLatency.store(getProcessingLatency());
+}
+
+int DistortionAudioProcessor::getProcessingLatency() const
+{
+	return m_oversamplers[0].getLatency() + m_limiter.getLatency();
+}
+
+void DistortionAudioProcessor::reportLatency()
+{
+	const int latency = m_pendingLatency.exchange(-1);
+
+	if (latency >= 0)
+		setLatencySamples(latency);
+}
 
-	m_outputEnvelope[0].setCoef(attack, release);
-	m_outputEnvelope[1].setCoef(attack, release);
+void DistortionAudioProcessor::timerCallback()
+{
+	reportLatency();
+}
 
+void DistortionAudioProcessor::updateBands(int bands)
+{
+	// Band states are preallocated, switching only clears them
+	m_bands = bands;
+	resetChannelState();
 }
 
 void DistortionAudioProcessor::releaseResources()
 {
+	RealtimeAudit::checkBoundary("releaseResources");
+
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
 }
@@ -178,12 +492,9 @@ bool DistortionAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any discrete layout works, channels are processed in groups of up
+    // to Float4::size with state sized in prepareToPlay
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -197,88 +508,626 @@ bool DistortionAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 }
 #endif
 
+template <typename SampleType>
+static float getPeak(const juce::AudioBuffer<SampleType>& buffer, int channels, int offset, int samples)
+{
+	float peak = 0.0f;
+
+	for (int channel = 0; channel < channels; ++channel)
+		peak = juce::jmax(peak, (float)buffer.getMagnitude(channel, offset, samples));
+
+	return peak;
+}
+
 void DistortionAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+	processBlockInternal(buffer, false);
+}
+
+void DistortionAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+	processBlockInternal(buffer, false);
+}
+
+void DistortionAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+	processBlockInternal(buffer, true);
+}
+
+void DistortionAudioProcessor::processBlockBypassed (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+	processBlockInternal(buffer, true);
+}
+
+template <typename SampleType>
+void DistortionAudioProcessor::processBlockInternal(juce::AudioBuffer<SampleType>& buffer, bool hostBypassed)
+{
+	// Offline renders may allocate, they run the worker pool
+	const RealtimeAudit::ScopedCallback audit(!isNonRealtime());
+	juce::ScopedNoDenormals noDenormals;
+
+	const auto startTicks = m_telemetry.beginBlock();
+	const int numSamples = buffer.getNumSamples();
+	bool idle = true;
+
+	// Longer blocks than prepared go in parts, the bypass delay lines hold one
+	// prepared block. Empty blocks still pick up parameter changes.
+	int offset = 0;
+
+	do
+	{
+		const int count = juce::jmin(m_maxBlock, numSamples - offset);
+		idle = processRange(buffer, offset, count, hostBypassed) && idle;
+		offset += count;
+	}
+	while (offset < numSamples);
+
+	m_telemetry.endBlock(startTicks, numSamples, idle);
+}
+
+template <typename SampleType>
+bool DistortionAudioProcessor::processRange(juce::AudioBuffer<SampleType>& buffer, int offset, int samples, bool hostBypassed)
 {
 	// Get params
-	const auto drive = driveParameter->load();
-	const auto dynamics = dynamicsParameter->load();
-	const auto frequency = frequencyParameter->load();
-	const auto resonance = resonanceParameter->load() * 4.0f;
-	const auto volume = juce::Decibels::decibelsToGain(volumeParameter->load());
-	const auto mix = mixParameter->load();
+	m_driveSmoother.setTargetValue(driveParameter->load());
+	m_dynamicsSmoother.setTargetValue(dynamicsParameter->load());
+	m_frequencySmoother.setTargetValue(frequencyParameter->load());
+	m_resonanceSmoother.setTargetValue(resonanceParameter->load() * 4.0f);
+	m_mixSmoother.setTargetValue(mixParameter->load());
+
+	if (volumeParameter->load() != m_volumeDecibels)
+	{
+		m_volumeDecibels = volumeParameter->load();
+		m_volumeSmoother.setTargetValue(juce::Decibels::decibelsToGain(m_volumeDecibels));
+	}
+
+	for (int split = 0; split < Crossover::MAX_SPLITS; ++split)
+		m_crossoverSmoothers[split].setTargetValue(crossoverParameters[split]->load());
 
-	// Mics constants
-	const float driveExponent = (drive >= 0.0f) ? 1.0f - (0.99f * drive) : 1.0f - 3.0f * drive;
-	const float mixInverse = 1.0f - mix;
-	const int channels = getTotalNumOutputChannels();
-	const int samples = buffer.getNumSamples();
+	for (int i = 0; i < Crossover::MAX_BANDS * N_BAND_PARAMS; ++i)
+		m_bandSmoothers[i].setTargetValue(bandParameters[i]->load());
 
-	float gainComponsation = 0.0f;
+	const auto accuracy = m_offline ? WaveshaperAccuracy::exact : (WaveshaperAccuracy)(int)shaperParameter->load();
+	const int channels = juce::jmin(getTotalNumOutputChannels(), buffer.getNumChannels(), m_channels);
+
+	SampleType** subBlockChannels = std::get<SampleType**>(m_subBlockChannels);
 
 	for (int channel = 0; channel < channels; ++channel)
+		subBlockChannels[channel] = buffer.getWritePointer(channel) + offset;
+
+	// Fully bypassed blocks are the input delayed by the latency, which holds
+	// still until processing resumes. The state is left as it was.
+	m_bypass.set(hostBypassed || bypassParameter->load() > 0.5f);
+	m_bypass.pushInput(subBlockChannels, channels, samples);
+
+	const int holdSamples = getProcessingLatency() + (int)(IDLE_HOLD_SECONDS * m_sampleRate);
+
+	if (m_bypass.isBypassed())
 	{
-		auto* channelBuffer = buffer.getWritePointer(channel);
-		auto& lowPassFilter = m_lowPassFilter[channel];
-		auto& inputEnvelope = m_inputEnvelope[channel];
-		auto& outputEnvelope = m_outputEnvelope[channel];
+		m_bypass.processBypassed(subBlockChannels, channels, samples, getProcessingLatency());
+		skipSmoothers(samples);
+		m_bypassedSamples = juce::jmin(m_bypassedSamples + samples, holdSamples);
+		return true;
+	}
+
+	// Multiband runs on the SIMD kernel only, without oversampling
+	const int bands = (m_kernelType == KernelType::simd) ? (int)bandsParameter->load() + 1 : 1;
+
+	if (bands != m_bands)
+		updateBands(bands);
+
+	// Does not allocate, but changes latency and resets the filters
+	const int oversampling = (m_bands > 1) ? 0 : getOversampling();
+
+	if (m_kernelType == KernelType::simd && oversampling != m_oversamplers[0].getFactorLog2())
+		updateOversampling(oversampling);
+
+	// Same for the limiter, whose latency follows the lookahead. The host hears
+	// of it from the timer. While it is off the kernels keep the plain clip.
+	const bool limiterEnabled = limiterParameter->load() > 0.5f;
+	const int limiterLatency = m_limiter.getLatency();
+	m_limiter.set(limiterEnabled, lookaheadParameter->load());
+
+	if (m_limiter.getLatency() != limiterLatency)
+		updateLatency();
+
+	m_kernelParameters.clipLevel = limiterEnabled ? std::numeric_limits<float>::max() : 1.0f;
 
-		// Set filter
-		lowPassFilter.set(frequency, 0.707f + resonance);
+	// Window in whole gain intervals, within the rings sized by prepareToPlay
+	const float windowIntervals = windowParameter->load() * 0.001f * (float)m_sampleRate / (float)m_gainInterval;
+	m_kernelParameters.detector = (DetectorMode)(int)detectorParameter->load();
+	m_kernelParameters.windowLength = juce::jlimit(1, m_kernelParameters.windowCapacity, juce::roundToInt(windowIntervals));
+
+	// Switching filters clears their state
+	const bool modulatedFilter = filterParameter->load() > 0.5f;
+
+	if (modulatedFilter != m_modulatedFilter)
+	{
+		m_modulatedFilter = modulatedFilter;
+		resetChannelState();
+	}
+
+	// Back from bypass. A state older than the idle hold would have decayed
+	// by now, so it restarts from zero, and the fade in waits until the
+	// processing has let out what it held.
+	if (m_bypassedSamples > 0)
+	{
+		if (m_bypassedSamples >= holdSamples)
+			resetChannelState();
+
+		m_bypass.resume(getProcessingLatency());
+		m_bypassedSamples = 0;
+	}
+
+	// While idle the state is flushed and silence stays silence. A parameter
+	// change could make the input audible, so it wakes the processor too.
+	const float inputPeak = getPeak(buffer, channels, offset, samples);
+
+	if (m_idle.load(std::memory_order_relaxed))
+	{
+		if (inputPeak < IDLE_THRESHOLD && !isSmoothing())
+		{
+			for (int channel = 0; channel < channels; ++channel)
+				buffer.clear(channel, offset, samples);
+
+			if (m_bypass.isFading())
+				m_bypass.mix(subBlockChannels, channels, samples, getProcessingLatency());
+
+			pushDisplayFrame(0.0f, 0.0f);
+			return true;
+		}
+
+		// Resumes from zero state, which is where the filters had decayed to
+		m_idle.store(false, std::memory_order_relaxed);
+		m_silentSamples = 0;
+	}
+
+	for (int start = 0; start < samples;)
+	{
+		// All parameters at their targets, process the rest of the block
+		// without any per-sample parameter work. The next ramp starts a new
+		// control interval.
+		if (!isSmoothing())
+		{
+			m_controlPhase = 0;
+
+			setParameters(accuracy, m_driveSmoother.getTargetValue(), m_dynamicsSmoother.getTargetValue(), m_frequencySmoother.getTargetValue(),
+			              m_resonanceSmoother.getTargetValue(), m_volumeSmoother.getTargetValue(), m_mixSmoother.getTargetValue());
+			setBandParameters(0, m_volumeSmoother.getTargetValue(), m_mixSmoother.getTargetValue());
+
+			for (int channel = 0; channel < channels; ++channel)
+				subBlockChannels[channel] = buffer.getWritePointer(channel, offset + start);
+
+			processSubBlock(subBlockChannels, channels, samples - start, nullptr);
+			break;
+		}
+
+		// Up to the next control point
+		const int count = juce::jmin(CONTROL_INTERVAL - m_controlPhase, samples - start);
+
+		// Gains ramp per sample
+		float dynamicsRamp[CONTROL_INTERVAL];
+		float wetGainRamp[CONTROL_INTERVAL];
+		float dryGainRamp[CONTROL_INTERVAL];
+
+		for (int sample = 0; sample < count; ++sample)
+		{
+			const float mix = m_mixSmoother.getNextValue();
+			dynamicsRamp[sample] = m_dynamicsSmoother.getNextValue();
+			wetGainRamp[sample] = m_volumeSmoother.getNextValue() * mix;
+			dryGainRamp[sample] = 1.0f - mix;
+		}
+
+		KernelRamps ramps;
+		ramps.dynamics = dynamicsRamp;
+		ramps.wetGain = wetGainRamp;
+		ramps.dryGain = dryGainRamp;
+
+		// Shaper and filter follow at control rate, stepping a whole interval at
+		// its first sample. A moving Drive would rebuild the lookup table every
+		// interval, so the approximation stands in for it.
+		if (m_controlPhase == 0)
+		{
+			const bool driveSmoothing = m_driveSmoother.isSmoothing();
+			const auto rampAccuracy = (driveSmoothing && accuracy == WaveshaperAccuracy::table) ? WaveshaperAccuracy::approximate : accuracy;
+
+			setParameters(rampAccuracy, m_driveSmoother.skip(CONTROL_INTERVAL), m_dynamicsSmoother.getCurrentValue(), m_frequencySmoother.skip(CONTROL_INTERVAL),
+			              m_resonanceSmoother.skip(CONTROL_INTERVAL), m_volumeSmoother.getCurrentValue(), m_mixSmoother.getCurrentValue());
+			setBandParameters(CONTROL_INTERVAL, m_volumeSmoother.getCurrentValue(), m_mixSmoother.getCurrentValue());
+		}
+
+		for (int channel = 0; channel < channels; ++channel)
+			subBlockChannels[channel] = buffer.getWritePointer(channel, offset + start);
+
+		processSubBlock(subBlockChannels, channels, count, &ramps);
+
+		m_controlPhase = (m_controlPhase + count) % CONTROL_INTERVAL;
+		start += count;
+	}
+
+	for (int channel = 0; channel < channels; ++channel)
+		subBlockChannels[channel] = buffer.getWritePointer(channel) + offset;
+
+	if (m_limiter.isEnabled())
+		m_limiter.process(subBlockChannels, channels, samples);
+
+	if (m_bypass.isFading())
+		m_bypass.mix(subBlockChannels, channels, samples, getProcessingLatency());
+
+	const float outputPeak = getPeak(buffer, channels, offset, samples);
+	pushDisplayFrame(inputPeak, outputPeak);
+
+	// Count silent input, go idle once the tail has decayed as well
+	m_silentSamples = (inputPeak < IDLE_THRESHOLD) ? juce::jmin(m_silentSamples + samples, holdSamples) : 0;
+
+	if (m_silentSamples >= holdSamples && !isSmoothing() && outputPeak < IDLE_THRESHOLD)
+	{
+		resetChannelState();
+		m_idle.store(true, std::memory_order_relaxed);
+	}
+
+	return false;
+}
+
+void DistortionAudioProcessor::pushDisplayFrame(float inputLevel, float outputLevel)
+{
+	DisplayFrame frame;
+	frame.exponent = m_waveshaper.getExponent();
+	frame.wetGain = m_kernelParameters.wetGain;
+	frame.dryGain = m_kernelParameters.dryGain;
+	frame.inputLevel = inputLevel;
+	frame.outputLevel = outputLevel;
+
+	m_displayFeed.push(frame);
+}
+
+void DistortionAudioProcessor::skipSmoothers(int samples)
+{
+	for (auto& smoother : m_crossoverSmoothers)
+		smoother.skip(samples);
+
+	for (auto& smoother : m_bandSmoothers)
+		smoother.skip(samples);
+
+	m_driveSmoother.skip(samples);
+	m_dynamicsSmoother.skip(samples);
+	m_frequencySmoother.skip(samples);
+	m_resonanceSmoother.skip(samples);
+	m_mixSmoother.skip(samples);
+	m_volumeSmoother.skip(samples);
+
+	m_controlPhase = (m_controlPhase + samples) % CONTROL_INTERVAL;
+}
+
+bool DistortionAudioProcessor::isSmoothing() const
+{
+	for (const auto& smoother : m_crossoverSmoothers)
+		if (smoother.isSmoothing())
+			return true;
+
+	for (const auto& smoother : m_bandSmoothers)
+		if (smoother.isSmoothing())
+			return true;
+
+	return m_driveSmoother.isSmoothing()
+		|| m_dynamicsSmoother.isSmoothing()
+		|| m_frequencySmoother.isSmoothing()
+		|| m_resonanceSmoother.isSmoothing()
+		|| m_mixSmoother.isSmoothing()
+		|| m_volumeSmoother.isSmoothing();
+}
+
+static float getDriveExponent(float drive)
+{
+	return (drive >= 0.0f) ? 1.0f - (0.99f * drive) : 1.0f - 3.0f * drive;
+}
+
+void DistortionAudioProcessor::setParameters(WaveshaperAccuracy accuracy, float drive, float dynamics, float frequency, float resonance, float volume, float mix)
+{
+	// Set shaper, together so the lookup table is rebuilt at most once
+	m_waveshaper.set(accuracy, getDriveExponent(drive));
+
+	// Set filters, coefficients are only recalculated when they change
+	const float Q = 0.707f + resonance;
+
+	forEachScalarState([this, frequency, Q](auto& state)
+	{
+		for (int channel = 0; channel < m_channels && state.lowPassFilter != nullptr; ++channel)
+			state.lowPassFilter[channel].set(frequency, Q);
+	});
+
+	m_kernelFilter.set(frequency, Q);
+
+	auto& params = m_kernelParameters;
+	params.dynamics = dynamics;
+	params.wetGain = volume * mix;
+	params.dryGain = 1.0f - mix;
+	params.a0 = m_kernelFilter.getA0();
+	params.a1 = m_kernelFilter.getA1();
+	params.a2 = m_kernelFilter.getA2();
+	params.b1 = m_kernelFilter.getB1();
+	params.b2 = m_kernelFilter.getB2();
+
+	// State variable filter runs at the host rate
+	params.prewarp = (m_modulatedFilter && m_tables != nullptr) ? &m_tables->getPrewarpTable() : nullptr;
+
+	if (frequency != m_cutoffFrequency)
+	{
+		m_cutoffFrequency = frequency;
+		m_cutoffOctave = std::log2(frequency / (float)m_sampleRate);
+	}
+
+	params.cutoffOctave = m_cutoffOctave;
+	params.modulationDepth = cutoffModParameter->load();
+	params.svfK = 1.0f / Q;
+}
+
+void DistortionAudioProcessor::setBandParameters(int count, float volume, float mix)
+{
+	// Crossover frequencies must ascend
+	float frequencies[Crossover::MAX_SPLITS];
+
+	for (int split = 0; split < Crossover::MAX_SPLITS; ++split)
+	{
+		const float frequency = m_crossoverSmoothers[split].skip(count);
+		frequencies[split] = (split > 0) ? juce::jmax(frequency, frequencies[split - 1]) : frequency;
+	}
+
+	m_crossover.set(m_bands, frequencies);
+
+	// Band Drive and Dynamics replace the global ones, band Mix scales the
+	// global Mix
+	auto& params = m_bandParameters;
+
+	for (int band = 0; band < Crossover::MAX_BANDS; ++band)
+	{
+		auto* smoothers = m_bandSmoothers + band * N_BAND_PARAMS;
+		const float drive = smoothers[0].skip(count);
+		const float dynamics = smoothers[1].skip(count);
+		const float bandMix = smoothers[2].skip(count);
+		const bool used = band < m_bands;
+
+		params.exponent[band] = getDriveExponent(drive);
+		params.dynamics[band] = dynamics;
+		params.wetGain[band] = used ? volume * mix * bandMix : 0.0f;
+		params.dryGain[band] = used ? 1.0f - mix * bandMix : 0.0f;
+		params.mix[band] = used ? bandMix : 0.0f;
+		params.dryOffset[band] = used ? 1.0f - bandMix : 0.0f;
+	}
+}
+
+void DistortionAudioProcessor::processSubBlock(float* const* channelBuffers, int channels, int samples, const KernelRamps* ramps)
+{
+	if (m_kernelType == KernelType::scalar)
+	{
+		processScalarGroups(channelBuffers, channels, samples, ramps);
+		return;
+	}
+
+	const auto& params = m_kernelParameters;
+
+	// One lane per channel, the last group may be partly filled
+	auto processGroup = [&](int group, int thread)
+	{
+		const int first = group * m_groupWidth;
+		const int groupChannels = juce::jmin(m_groupWidth, channels - first);
+
+		if (m_bands > 1)
+			SIMDKernel::processMultiband(channelBuffers + first, groupChannels, samples, params, m_bandParameters, ramps, m_waveshaper, m_crossover, m_crossoverState[group], m_bandState + first);
+		else if (m_oversamplers[thread].getFactorLog2() > 0)
+			SIMDKernel::processOversampled(channelBuffers + first, groupChannels, samples, params, ramps, m_waveshaper, m_oversamplers[thread], m_oversamplerState[group], m_channelGroupState[group]);
+		else
+			SIMDKernel::process(channelBuffers + first, groupChannels, samples, params, ramps, m_waveshaper, m_channelGroupState[group]);
+	};
+
+	forEachChannelGroup(channels, processGroup);
+}
+
+void DistortionAudioProcessor::processSubBlock(double* const* channelBuffers, int channels, int samples, const KernelRamps* ramps)
+{
+	processScalarGroups(channelBuffers, channels, samples, ramps);
+}
+
+template <typename SampleType>
+void DistortionAudioProcessor::processScalarGroups(SampleType* const* channelBuffers, int channels, int samples, const KernelRamps* ramps)
+{
+	// Channels are independent, a group is a range of them
+	auto processGroup = [&](int group, int)
+	{
+		const int first = group * m_groupWidth;
+		processScalarWithFlags(channelBuffers, first, juce::jmin(first + m_groupWidth, channels), samples, ramps);
+	};
+
+	forEachChannelGroup(channels, processGroup);
+}
+
+template <typename SampleType>
+void DistortionAudioProcessor::processScalarWithFlags(SampleType* const* channelBuffers, int firstChannel, int endChannel, int samples, const KernelRamps* ramps)
+{
+	// Modulated always comes with dynamics
+	switch (KernelFlags::get(m_kernelParameters, ramps, m_waveshaper.getExponent()))
+	{
+	case 0: processScalar<SampleType, 0>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 1: processScalar<SampleType, 1>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 2: processScalar<SampleType, 2>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 3: processScalar<SampleType, 3>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 4: processScalar<SampleType, 4>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 5: processScalar<SampleType, 5>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 6: processScalar<SampleType, 6>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 7: processScalar<SampleType, 7>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 9: processScalar<SampleType, 9>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 11: processScalar<SampleType, 11>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	case 13: processScalar<SampleType, 13>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	default: processScalar<SampleType, 15>(channelBuffers, firstChannel, endChannel, samples, ramps); break;
+	}
+}
+
+template <typename SampleType, int flags>
+void DistortionAudioProcessor::processScalar(SampleType* const* channelBuffers, int firstChannel, int endChannel, int samples, const KernelRamps* ramps)
+{
+	const bool dynamicsOn = (flags & KernelFlags::dynamics) != 0;
+	const bool mixed = (flags & KernelFlags::mixed) != 0;
+	const bool identity = (flags & KernelFlags::identity) != 0;
+	const bool modulated = (flags & KernelFlags::modulated) != 0;
+
+	const auto& params = m_kernelParameters;
+	const auto& state = std::get<ScalarKernelState<SampleType>>(m_scalarState);
+	const SampleType gainIntervalInverse = SampleType(1) / (SampleType)params.gainInterval;
+	const SampleType one = SampleType(1);
+	const SampleType clipLevel = params.clipLevel;
+	const SampleType svfK = params.svfK;
+	const bool antiderivative = m_waveshaper.getAccuracy() == WaveshaperAccuracy::antiderivative;
+	const bool kWeighted = params.detector == DetectorMode::kWeighted;
+	const SampleType windowInverse = SampleType(1) / (SampleType)params.windowLength;
+
+	// Level of one gain interval, from its peak or its sum of squares. The RMS
+	// detectors average the interval energies over the window.
+	auto getLevel = [&](SampleType accumulated, LoudnessWindowState<SampleType>& window, SampleType* ring)
+	{
+		if (params.detector == DetectorMode::peak)
+			return accumulated;
+
+		const SampleType sum = LoudnessWindow::push(window, ring, params.windowCapacity, params.windowLength, accumulated * gainIntervalInverse);
+		return std::sqrt(std::max(sum * windowInverse, SampleType(0)));
+	};
+
+	auto weight = [&](SampleType in, SampleType* z)
+	{
+		return KWeighting::processStage(KWeighting::processStage(in, params.shelf, z[0], z[1]), params.highPass, z[2], z[3]);
+	};
+
+	for (int channel = firstChannel; channel < endChannel; ++channel)
+	{
+		auto* channelBuffer = channelBuffers[channel];
+		auto& lowPassFilter = state.lowPassFilter[channel];
+		auto& inputEnvelope = state.inputEnvelope[channel];
+		auto& outputEnvelope = state.outputEnvelope[channel];
+		auto& gainState = state.gainState[channel];
+		auto& filterState = state.modulatedFilter[channel];
+		auto& shaperHistory = state.shaperHistory[channel];
+		auto& detectorState = state.detector[channel];
+		SampleType* inputRing = state.detectorHistory + channel * 2 * params.windowCapacity;
+		SampleType* outputRing = inputRing + params.windowCapacity;
+
+		if (antiderivative)
+			m_waveshaper.updateHistory(shaperHistory);
 
 		for (int sample = 0; sample < samples; ++sample)
 		{
 			// Get input
-			const float in = channelBuffer[sample];
+			const SampleType in = channelBuffer[sample];
 
-			// Get input loudness
-			const float inputLoudness = inputEnvelope.process(in);
+			// Distort, an exponent of 1 passes the input through
+			SampleType inDistorted = in;
 
-			// Distort
-			const float sign = (in >= 0.0f) ? 1.0f : -1.0f;
-			const float inDistorted = sign * powf(fabsf(in), driveExponent);
-
-			// Low pass filter
-			const float inFiltered = lowPassFilter.process(inDistorted);
+			if (!identity && antiderivative)
+			{
+				inDistorted = m_waveshaper.processAntiderivative(in, shaperHistory);
+			}
+			else if (!identity)
+			{
+				const SampleType sign = (in >= SampleType(0)) ? one : -one;
+				inDistorted = sign * m_waveshaper.processMagnitude(std::abs(in));
+			}
 
-			// Get output loundess
-			const float outputLoudness = outputEnvelope.process(inFiltered);
+			// Low pass filter, the state variable one with its cutoff ramping
+			SampleType inFiltered;
 
-			// Get gain compensation
-			float gainComponesation = 1.0f;
-			
-			if (outputLoudness > 0.001f)
+			if (modulated)
 			{
-				gainComponesation = inputLoudness / outputLoudness;
+				filterState.cutoffOffset = filterState.cutoffOffset + filterState.cutoffStep;
+				const SampleType g = params.prewarp->lookup(params.cutoffOctave + filterState.cutoffOffset);
+				inFiltered = StateVariableFilter::processLowPass(inDistorted, g, svfK, filterState.z1, filterState.z2);
+			}
+			else
+			{
+				inFiltered = lowPassFilter.process(inDistorted);
+			}
 
-				if (gainComponesation < 1.0f)
-				{
-					const float delta = 1.0f - gainComponesation;
-					gainComponesation = 1.0f - (delta * dynamics);
-				}
-				else
-				{
-					const float delta = gainComponesation - 1.0f;
-					gainComponesation = 1.0f + (delta * dynamics);
-				}
+			// Get smoothed params
+			const SampleType wetGain = (ramps != nullptr) ? ramps->wetGain[sample] : params.wetGain;
+			const SampleType dryGain = (ramps != nullptr) ? ramps->dryGain[sample] : params.dryGain;
+
+			// Get input and output peaks, or sums of squares for the RMS
+			// detectors, ramp gain compensation
+			if (dynamicsOn && params.detector == DetectorMode::peak)
+			{
+				gainState.inputPeak = std::fmax(gainState.inputPeak, std::abs(in));
+				gainState.outputPeak = std::fmax(gainState.outputPeak, std::abs(inFiltered));
+			}
+			else if (dynamicsOn)
+			{
+				const SampleType inputDetected = kWeighted ? weight(in, detectorState.inputWeighting) : in;
+				const SampleType outputDetected = kWeighted ? weight(inFiltered, detectorState.outputWeighting) : inFiltered;
+				gainState.inputPeak = gainState.inputPeak + inputDetected * inputDetected;
+				gainState.outputPeak = gainState.outputPeak + outputDetected * outputDetected;
 			}
 
+			if (dynamicsOn)
+				gainState.gain = gainState.gain + gainState.gainStep;
+
 			// Apply volume and mix
-			const float inVolume = volume * mix * inFiltered * gainComponesation + mixInverse * in;
+			const SampleType inWet = dynamicsOn ? wetGain * inFiltered * gainState.gain : wetGain * inFiltered;
+			const SampleType inVolume = mixed ? inWet + dryGain * in : inWet;
 
-			// Clip to <-1.0, 1.0> range
-			if (inVolume > 1.0f)
+			// Clip to <-clipLevel, clipLevel> range
+			if (inVolume > clipLevel)
 			{
-				channelBuffer[sample] = 1.0f;
+				channelBuffer[sample] = clipLevel;
 			}
-			else if (inVolume < -1.0f)
+			else if (inVolume < -clipLevel)
 			{
-				channelBuffer[sample] = -1.0f;
+				channelBuffer[sample] = -clipLevel;
 			}
 			else
 			{
 				channelBuffer[sample] = inVolume;
 			}
+
+			// Update gain compensation at control rate
+			if (!dynamicsOn || ++gainState.phase < params.gainInterval)
+				continue;
+
+			// Get input and output loudness
+			const SampleType inputLoudness = inputEnvelope.process(getLevel(gainState.inputPeak, detectorState.inputWindow, inputRing));
+			const SampleType outputLoudness = outputEnvelope.process(getLevel(gainState.outputPeak, detectorState.outputWindow, outputRing));
+
+			const SampleType dynamics = (ramps != nullptr) ? ramps->dynamics[sample] : params.dynamics;
+
+			// Get gain compensation
+			SampleType gainComponesation = one;
+			
+			if (outputLoudness > SampleType(0.001))
+			{
+				gainComponesation = inputLoudness / outputLoudness;
+
+				if (gainComponesation < one)
+				{
+					const SampleType delta = one - gainComponesation;
+					gainComponesation = one - (delta * dynamics);
+				}
+				else
+				{
+					const SampleType delta = gainComponesation - one;
+					gainComponesation = one + (delta * dynamics);
+				}
+			}
+
+			// Ramp to it over the next interval
+			gainState.gainStep = (gainComponesation - gainState.gain) * gainIntervalInverse;
+			gainState.inputPeak = SampleType(0);
+			gainState.outputPeak = SampleType(0);
+			gainState.phase = 0;
+
+			// Cutoff follows the input loudness over the next interval
+			if (modulated)
+				filterState.cutoffStep = (params.modulationDepth * (float)inputLoudness - filterState.cutoffOffset) * (1.0f / (float)params.gainInterval);
 		}
+
+		// Without dynamics the gain is 1. The envelopes keep their last values
+		// and the gain restarts from 1 when Dynamics comes back.
+		if (!dynamicsOn)
+			gainState = {};
 	}
 }
 
@@ -296,13 +1145,20 @@ juce::AudioProcessorEditor* DistortionAudioProcessor::createEditor()
 //==============================================================================
 void DistortionAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-	auto state = apvts.copyState();
-	std::unique_ptr<juce::XmlElement> xml(state.createXml());
-	copyXmlToBinary(*xml, destData);
+	m_presetBank.writeState(destData, m_currentProgram);
 }
 
 void DistortionAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
+	int program = 0;
+
+	if (m_presetBank.readState(data, sizeInBytes, program))
+	{
+		m_currentProgram = juce::jlimit(0, m_presetBank.getNumPresets() - 1, program);
+		return;
+	}
+
+	// XML state written by earlier versions
 	std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
 
 	if (xmlState.get() != nullptr)
@@ -323,6 +1179,30 @@ juce::AudioProcessorValueTreeState::ParameterLayout DistortionAudioProcessor::cr
 	layout.add(std::make_unique<juce::AudioParameterFloat>(paramsNames[4], paramsNames[4], NormalisableRange<float>(  0.0f,     1.0f, 0.01f, 1.0f),      1.0f));
 	layout.add(std::make_unique<juce::AudioParameterFloat>(paramsNames[5], paramsNames[5], NormalisableRange<float>(-36.0f,    36.0f,  0.1f, 1.0f),      0.0f));
 
+	layout.add(std::make_unique<juce::AudioParameterChoice>(settingsNames[0], settingsNames[0], StringArray{ "Exact", "Fast", "Table", "ADAA" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterChoice>(settingsNames[1], settingsNames[1], StringArray{ "Off", "2x", "4x", "8x" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterChoice>(settingsNames[2], settingsNames[2], StringArray{ "Off", "On" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterFloat>(settingsNames[3], settingsNames[3], NormalisableRange<float>(0.5f, Limiter::MAX_LOOKAHEAD_MS, 0.1f, 1.0f), 2.0f));
+	layout.add(std::make_unique<juce::AudioParameterChoice>(settingsNames[4], settingsNames[4], StringArray{ "Biquad", "SVF" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterFloat>(settingsNames[5], settingsNames[5], NormalisableRange<float>(-4.0f, 4.0f, 0.01f, 1.0f), 0.0f));
+	layout.add(std::make_unique<juce::AudioParameterChoice>(settingsNames[6], settingsNames[6], StringArray{ "Peak", "RMS", "K-weighted" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterFloat>(settingsNames[7], settingsNames[7], NormalisableRange<float>(10.0f, (float)LoudnessWindow::MAX_MILLISECONDS, 1.0f, 0.4f), 400.0f));
+
+	layout.add(std::make_unique<juce::AudioParameterBool>(bypassName, bypassName, false));
+
+	layout.add(std::make_unique<juce::AudioParameterChoice>(multibandNames[0], multibandNames[0], StringArray{ "Off", "2", "3", "4" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterFloat>(multibandNames[1], multibandNames[1], NormalisableRange<float>(40.0f, 16000.0f, 1.0f, 0.4f),  200.0f));
+	layout.add(std::make_unique<juce::AudioParameterFloat>(multibandNames[2], multibandNames[2], NormalisableRange<float>(40.0f, 16000.0f, 1.0f, 0.4f), 1000.0f));
+	layout.add(std::make_unique<juce::AudioParameterFloat>(multibandNames[3], multibandNames[3], NormalisableRange<float>(40.0f, 16000.0f, 1.0f, 0.4f), 5000.0f));
+
+	for (int band = 0; band < Crossover::MAX_BANDS; ++band)
+	{
+		const auto* names = bandParamsNames + band * N_BAND_PARAMS;
+		layout.add(std::make_unique<juce::AudioParameterFloat>(names[0], names[0], NormalisableRange<float>(-1.0f, 1.0f, 0.01f, 1.0f), 0.0f));
+		layout.add(std::make_unique<juce::AudioParameterFloat>(names[1], names[1], NormalisableRange<float>( 0.0f, 1.0f, 0.01f, 1.0f), 0.0f));
+		layout.add(std::make_unique<juce::AudioParameterFloat>(names[2], names[2], NormalisableRange<float>( 0.0f, 1.0f, 0.01f, 1.0f), 1.0f));
+	}
+
 	return layout;
 }
 
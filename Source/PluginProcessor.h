@@ -9,8 +9,22 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Bypass.h"
+#include "DisplayFeed.h"
+#include "Limiter.h"
+#include "LoudnessDetector.h"
+#include "PresetBank.h"
+#include "RealtimeAudit.h"
+#include "SIMDKernel.h"
+#include "SharedTables.h"
+#include "Telemetry.h"
+#include "WorkerPool.h"
+#include <tuple>
 
 //==============================================================================
+// Scalar DSP is templated on the sample type, so the float and double
+// processBlock share one implementation
+template <typename SampleType>
 class EnvelopeFollower
 {
 public:
@@ -18,36 +32,99 @@ public:
 
 	void init(int sampleRate) { m_SampleRate = sampleRate; }
 	void setCoef(float attackTime, float releaseTime);
-	float process(float in);
+	SampleType process(SampleType in);
+	void reset() { m_OutLast = SampleType(0); m_Out1Last = SampleType(0); }
+
+	SampleType getAttackCoef() const { return m_AttackCoef; }
+	SampleType getReleaseCoef() const { return m_ReleaseCoef; }
 
 protected:
 	int  m_SampleRate = 48000;
-	float m_AttackCoef = 0.0f;
-	float m_ReleaseCoef = 0.0f;
+	SampleType m_AttackCoef = SampleType(0);
+	SampleType m_ReleaseCoef = SampleType(0);
 
-	float m_OutLast = 0.0f;
-	float m_Out1Last = 0.0f;
+	SampleType m_OutLast = SampleType(0);
+	SampleType m_Out1Last = SampleType(0);
 };
 
 //==============================================================================
+template <typename SampleType>
 class  BiquadLowPassFilter
 {
 public:
 	BiquadLowPassFilter() {};
 
-	inline void init(int sampleRate) { m_SampleRate = sampleRate; }
+	inline void init(int sampleRate) { m_SampleRate = sampleRate; m_frequency = -1.0f; }
 	void set(float frequency, float Q);
-	float process(float in);
+	SampleType process(SampleType in);
+	inline void reset() { z1 = SampleType(0); z2 = SampleType(0); }
+
+	SampleType getA0() const { return a0; }
+	SampleType getA1() const { return a1; }
+	SampleType getA2() const { return a2; }
+	SampleType getB1() const { return b1; }
+	SampleType getB2() const { return b2; }
 
 private:
 	int m_SampleRate = 48000;
-	float a0 = 0.0f;
-	float a1 = 0.0f;
-	float a2 = 0.0f;
-	float b1 = 0.0f;
-	float b2 = 0.0f;
-	float z1 = 0.0f;
-	float z2 = 0.0f;
+	float m_frequency = -1.0f;
+	float m_Q = 0.0f;
+	SampleType a0 = SampleType(0);
+	SampleType a1 = SampleType(0);
+	SampleType a2 = SampleType(0);
+	SampleType b1 = SampleType(0);
+	SampleType b2 = SampleType(0);
+	SampleType z1 = SampleType(0);
+	SampleType z2 = SampleType(0);
+};
+
+//==============================================================================
+// Gain compensation of one channel, updated every gain interval
+template <typename SampleType>
+struct GainComputerState
+{
+	SampleType inputPeak = SampleType(0);
+	SampleType outputPeak = SampleType(0);
+	SampleType gain = SampleType(1);
+	SampleType gainStep = SampleType(0);
+	int phase = 0;
+};
+
+// State variable filter of one channel, with the cutoff offset in octaves
+template <typename SampleType>
+struct ModulatedFilterState
+{
+	SampleType z1 = SampleType(0);
+	SampleType z2 = SampleType(0);
+	float cutoffOffset = 0.0f;
+	float cutoffStep = 0.0f;
+};
+
+// Windows and K-weighting filters of the RMS detectors of one channel
+template <typename SampleType>
+struct DetectorState
+{
+	LoudnessWindowState<SampleType> inputWindow;
+	LoudnessWindowState<SampleType> outputWindow;
+	SampleType inputWeighting[4] = {};
+	SampleType outputWeighting[4] = {};
+};
+
+// Scalar kernel state, one entry per channel
+template <typename SampleType>
+struct ScalarKernelState
+{
+	BiquadLowPassFilter<SampleType>* lowPassFilter = nullptr;
+	EnvelopeFollower<SampleType>* inputEnvelope = nullptr;
+	EnvelopeFollower<SampleType>* outputEnvelope = nullptr;
+	GainComputerState<SampleType>* gainState = nullptr;
+	ModulatedFilterState<SampleType>* modulatedFilter = nullptr;
+	AntiderivativeHistory<SampleType>* shaperHistory = nullptr;
+	DetectorState<SampleType>* detector = nullptr;
+
+	// Input then output ring of each channel, KernelParameters::windowCapacity
+	// entries each
+	SampleType* detectorHistory = nullptr;
 };
 
 //==============================================================================
@@ -57,6 +134,7 @@ class DistortionAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                             , private juce::Timer
 {
 public:
     //==============================================================================
@@ -64,6 +142,16 @@ public:
     ~DistortionAudioProcessor() override;
 
 	static const std::string paramsNames[];
+	static const std::string settingsNames[];
+
+	// Band count and crossover frequencies, then Drive, Dynamics and Mix of
+	// each band in band order
+	static const std::string multibandNames[];
+	static const std::string bandParamsNames[];
+	static const int N_BAND_PARAMS = 3;
+
+	// Host bypass, not part of presets
+	static const std::string bypassName;
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
@@ -74,6 +162,18 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+	// Hosts without a bypass parameter call these instead, they fade out
+	// like the parameter does
+	void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+	void processBlockBypassed (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+	juce::AudioProcessorParameter* getBypassParameter() const override { return apvts.getParameter(bypassName); }
+
+	// The double path runs the scalar kernel in double precision, the SIMD
+	// kernel and oversampling are float only
+	bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -103,6 +203,31 @@ public:
 
 	APVTS apvts{ *this, nullptr, "Parameters", createParameterLayout() };
 
+	Telemetry& getTelemetry() { return m_telemetry; }
+	DisplayFeed& getDisplayFeed() { return m_displayFeed; }
+
+	// Instances sharing the DSP tables, their size and how long they took to build
+	SharedTables::Stats getSharedTableStats() const { return m_sharedTables.getStats(); }
+
+	// Samples between gain compensation updates, applied by prepareToPlay
+	void setGainInterval(int samples) { m_gainInterval = juce::jlimit(1, MAX_GAIN_INTERVAL, samples); }
+	int getGainInterval() const { return m_gainInterval; }
+
+	static const int DEFAULT_GAIN_INTERVAL = 16;
+	static const int MAX_GAIN_INTERVAL = 256;
+
+	// Threads for the channel groups while rendering offline, applied by
+	// prepareToPlay. Defaults to one per CPU.
+	void setOfflineThreads(int threads) { m_offlineThreads = juce::jlimit(1, WorkerPool::MAX_THREADS, threads); }
+
+	// Kernel picked by prepareToPlay where the CPU and precision allow it. The
+	// scalar kernel is the reference the other kernels are tested against.
+	void setPreferredKernel(KernelType type) { m_preferredKernel = type; }
+	KernelType getKernelType() const { return m_kernelType; }
+
+	// True while silent input is passed over without running the DSP
+	bool isIdle() const { return m_idle.load(std::memory_order_relaxed); }
+
 private:	
 	//==============================================================================
 
@@ -112,12 +237,200 @@ private:
 	std::atomic<float>* resonanceParameter = nullptr;
 	std::atomic<float>* mixParameter = nullptr;
 	std::atomic<float>* volumeParameter = nullptr;
+	std::atomic<float>* shaperParameter = nullptr;
+	std::atomic<float>* oversamplingParameter = nullptr;
+	std::atomic<float>* limiterParameter = nullptr;
+	std::atomic<float>* lookaheadParameter = nullptr;
+	std::atomic<float>* filterParameter = nullptr;
+	std::atomic<float>* cutoffModParameter = nullptr;
+	std::atomic<float>* detectorParameter = nullptr;
+	std::atomic<float>* windowParameter = nullptr;
+	std::atomic<float>* bypassParameter = nullptr;
+
+	std::atomic<float>* bandsParameter = nullptr;
+	std::atomic<float>* crossoverParameters[Crossover::MAX_SPLITS] = {};
+	std::atomic<float>* bandParameters[Crossover::MAX_BANDS * N_BAND_PARAMS] = {};
 
 	juce::AudioParameterBool* autoGainReductionParameter = nullptr;
 
-	BiquadLowPassFilter m_lowPassFilter[2] = {};
-	EnvelopeFollower m_inputEnvelope[2] = {};
-	EnvelopeFollower m_outputEnvelope[2] = {};
+	Waveshaper m_waveshaper;
+
+	KernelType m_kernelType = KernelType::scalar;
+	KernelType m_preferredKernel = KernelType::simd;
+
+	// Stage buffers are shared by the groups an oversampler runs, so each
+	// thread has its own. The first one runs on the audio thread.
+	Oversampler m_oversamplers[WorkerPool::MAX_THREADS];
+
+	// Offline renders, latched by prepareToPlay, run the exact shaper with at
+	// least OFFLINE_OVERSAMPLING and split the channels into groups of
+	// m_groupWidth over the worker pool
+	static const int OFFLINE_OVERSAMPLING = 2;
+	bool m_offline = false;
+	int m_offlineThreads = juce::jmin(juce::SystemStats::getNumCpus(), (int)WorkerPool::MAX_THREADS);
+	int m_threads = 1;
+	int m_groupWidth = Float4::size;
+	WorkerPool m_workerPool;
+
+	// Per-channel state, sized in prepareToPlay from a single allocation
+	Arena m_arena;
+	int m_channels = 0;
+	int m_channelGroups = 0;
+
+	// Scalar kernel, only the precision in use is allocated
+	std::tuple<ScalarKernelState<float>, ScalarKernelState<double>> m_scalarState;
+
+	// SIMD kernel, one per group of m_groupWidth channels, each with an input
+	// and an output detector ring. The band states have their rings after those.
+	ChannelGroupState* m_channelGroupState = nullptr;
+	Float4* m_detectorHistory = nullptr;
+	Oversampler::State* m_oversamplerState = nullptr;
+
+	// Multiband, SIMD kernel only. One crossover state per group and one
+	// band state per channel, with lanes as bands.
+	Crossover m_crossover;
+	Crossover::State* m_crossoverState = nullptr;
+	ChannelGroupState* m_bandState = nullptr;
+	BandParameters m_bandParameters;
+	int m_bands = 1;
+
+	// Replaces the clip at the end of the kernels while enabled
+	Limiter m_limiter;
+
+	// Dry path of the host bypass. Blocks longer than the prepared size are
+	// split to fit its delay lines. While bypassed only the smoothers and the
+	// control grid advance, and m_bypassedSamples counts up to the idle hold,
+	// after which the state is cleared on the way back as the idle path does.
+	Bypass m_bypass;
+	int m_maxBlock = 1;
+	int m_bypassedSamples = 0;
+
+	// Channel pointers offset to the current sub-block
+	std::tuple<float**, double**> m_subBlockChannels;
+
+	// Coefficients for the SIMD kernel, at the oversampled rate
+	BiquadLowPassFilter<float> m_kernelFilter;
+
+	// Filter setting, the state variable filter takes the place of the biquad
+	// and follows the input envelope
+	bool m_modulatedFilter = false;
+
+	// Tables shared with the other instances, valid after prepareToPlay
+	SharedTables::Handle m_sharedTables;
+	const SharedTables* m_tables = nullptr;
+
+	KernelParameters m_kernelParameters;
+	int m_gainInterval = DEFAULT_GAIN_INTERVAL;
+
+	PresetBank m_presetBank;
+	int m_currentProgram = 0;
+
+	Telemetry m_telemetry;
+	DisplayFeed m_displayFeed;
+
+	// Latency changed by the audio thread, -1 once reported. Telling the host
+	// locks and calls into it, so that is left to prepareToPlay and the timer.
+	std::atomic<int> m_pendingLatency{ -1 };
+	static const int LATENCY_TIMER_HZ = 20;
+
+	// Idle once input has been below IDLE_THRESHOLD for IDLE_HOLD_SECONDS
+	// plus the latency and the output has decayed below it as well
+	static const float IDLE_THRESHOLD;
+	static const float IDLE_HOLD_SECONDS;
+
+	std::atomic<bool> m_idle{ false };
+	int m_silentSamples = 0;
+
+	int m_sampleRate = 48000;
+
+	// Smoothed values are ramped per sample (gains) or per CONTROL_INTERVAL
+	// samples (shaper and filter coefficients). Control points lie on a grid
+	// that runs across host blocks, m_controlPhase samples into the current
+	// interval, so small or odd host blocks do not add coefficient updates.
+	static const int CONTROL_INTERVAL = 32;
+	int m_controlPhase = 0;
+
+	// Per-block conversions, only redone when their input changes
+	float m_volumeDecibels = 0.0f;
+	float m_cutoffFrequency = 0.0f;
+	float m_cutoffOctave = 0.0f;
+
+	juce::SmoothedValue<float> m_driveSmoother;
+	juce::SmoothedValue<float> m_dynamicsSmoother;
+	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> m_frequencySmoother;
+	juce::SmoothedValue<float> m_resonanceSmoother;
+	juce::SmoothedValue<float> m_mixSmoother;
+	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> m_volumeSmoother;
+
+	// Band parameters follow at control rate only
+	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> m_crossoverSmoothers[Crossover::MAX_SPLITS];
+	juce::SmoothedValue<float> m_bandSmoothers[Crossover::MAX_BANDS * N_BAND_PARAMS];
+
+	void allocateChannelState(int channels);
+
+	template <typename SampleType>
+	void allocateScalarState(ScalarKernelState<SampleType>& state, int channels);
+
+	// Calls function with the float and the double scalar state. Only one is
+	// allocated, the other has null pointers.
+	template <typename Function>
+	void forEachScalarState(Function&& function)
+	{
+		function(std::get<ScalarKernelState<float>>(m_scalarState));
+		function(std::get<ScalarKernelState<double>>(m_scalarState));
+	}
+
+	void resetChannelState();
+	int getOversampling() const;
+	void updateOversampling(int factorLog2);
+	void updateBands(int bands);
+	void updateLatency();
+	int getProcessingLatency() const;
+	void reportLatency();
+	void timerCallback() override;
+	bool isSmoothing() const;
+	void skipSmoothers(int samples);
+	void pushDisplayFrame(float inputLevel, float outputLevel);
+	void setParameters(WaveshaperAccuracy accuracy, float drive, float dynamics, float frequency, float resonance, float volume, float mix);
+	void setBandParameters(int count, float volume, float mix);
+	template <typename SampleType>
+	void processBlockInternal(juce::AudioBuffer<SampleType>& buffer, bool hostBypassed);
+
+	// Samples from offset, up to m_maxBlock of them. True when the range was
+	// idle or fully bypassed.
+	template <typename SampleType>
+	bool processRange(juce::AudioBuffer<SampleType>& buffer, int offset, int samples, bool hostBypassed);
+
+	void processSubBlock(float* const* channelBuffers, int channels, int samples, const KernelRamps* ramps);
+	void processSubBlock(double* const* channelBuffers, int channels, int samples, const KernelRamps* ramps);
+
+	// Calls function(group, thread) for every group of m_groupWidth channels,
+	// spread over the worker pool while rendering offline
+	template <typename Function>
+	void forEachChannelGroup(int channels, Function& function)
+	{
+		const int groups = (channels + m_groupWidth - 1) / m_groupWidth;
+
+		if (isNonRealtime())
+		{
+			m_workerPool.run(groups, function);
+			return;
+		}
+
+		for (int group = 0; group < groups; ++group)
+			function(group, 0);
+	}
+
+	template <typename SampleType>
+	void processScalarGroups(SampleType* const* channelBuffers, int channels, int samples, const KernelRamps* ramps);
+
+	// Picks the processScalar instantiation for the block's KernelFlags.
+	// Processes channels [firstChannel, endChannel) of channelBuffers.
+	template <typename SampleType>
+	void processScalarWithFlags(SampleType* const* channelBuffers, int firstChannel, int endChannel, int samples, const KernelRamps* ramps);
+
+	template <typename SampleType, int flags>
+	void processScalar(SampleType* const* channelBuffers, int firstChannel, int endChannel, int samples, const KernelRamps* ramps);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DistortionAudioProcessor)
 };
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    Program bank of parameter snapshots, and the binary plugin state.
+
+  ==============================================================================
+*/
+
+#include "PresetBank.h"
+
+//==============================================================================
+namespace
+{
+	struct FactoryPreset
+	{
+		const char* name;
+
+		// Drive, Dynamics, Cutoff, Resonance, Mix, Volume, Shaper, Oversampling.
+		// Later parameters keep their default.
+		float values[8];
+	};
+
+	const FactoryPreset factoryPresets[] =
+	{
+		{ "Init",     {  0.0f, 0.0f, 20000.0f, 0.0f, 1.0f,  0.0f, 0.0f, 0.0f } },
+		{ "Warm",     {  0.3f, 0.5f,  8000.0f, 0.0f, 1.0f, -3.0f, 0.0f, 1.0f } },
+		{ "Crunch",   {  0.6f, 0.3f,  6000.0f, 0.2f, 1.0f, -6.0f, 0.0f, 1.0f } },
+		{ "Fuzz",     { 0.95f, 0.0f,  4000.0f, 0.3f, 1.0f, -9.0f, 0.0f, 2.0f } },
+		{ "Parallel", {  0.8f, 0.5f,  3000.0f, 0.1f, 0.4f,  0.0f, 0.0f, 1.0f } },
+		{ "Expand",   { -0.5f, 0.5f, 12000.0f, 0.0f, 1.0f,  0.0f, 0.0f, 0.0f } },
+		{ "Lo-Fi",    {  0.7f, 0.0f,  1500.0f, 0.6f, 1.0f, -3.0f, 2.0f, 0.0f } }
+	};
+}
+
+//==============================================================================
+void PresetBank::init(juce::AudioProcessorValueTreeState& apvts, const juce::StringArray& parameterIds)
+{
+	jassert(parameterIds.size() == ParameterSnapshot::SIZE);
+
+	for (int i = 0; i < ParameterSnapshot::SIZE; ++i)
+	{
+		m_parameters[i] = apvts.getParameter(parameterIds[i]);
+		jassert(m_parameters[i] != nullptr);
+	}
+
+	m_presets.clear();
+
+	for (const auto& factoryPreset : factoryPresets)
+	{
+		Preset preset;
+		preset.name = factoryPreset.name;
+
+		const int count = (int)(sizeof(factoryPreset.values) / sizeof(factoryPreset.values[0]));
+
+		for (int i = 0; i < ParameterSnapshot::SIZE; ++i)
+			preset.snapshot.values[i] = (i < count) ? m_parameters[i]->convertTo0to1(factoryPreset.values[i]) : m_parameters[i]->getDefaultValue();
+
+		m_presets.push_back(preset);
+	}
+}
+
+void PresetBank::apply(int index) const
+{
+	if (index >= 0 && index < getNumPresets())
+		apply(m_presets[(size_t)index].snapshot);
+}
+
+void PresetBank::apply(const ParameterSnapshot& snapshot) const
+{
+	for (int i = 0; i < ParameterSnapshot::SIZE; ++i)
+		if (m_parameters[i]->getValue() != snapshot.values[i])
+			m_parameters[i]->setValueNotifyingHost(snapshot.values[i]);
+}
+
+void PresetBank::capture(ParameterSnapshot& snapshot) const
+{
+	for (int i = 0; i < ParameterSnapshot::SIZE; ++i)
+		snapshot.values[i] = m_parameters[i]->getValue();
+}
+
+//==============================================================================
+void PresetBank::writeState(juce::MemoryBlock& destData, int program) const
+{
+	juce::MemoryOutputStream out(destData, false);
+
+	out.writeInt(STATE_MAGIC);
+	out.writeInt(STATE_VERSION);
+	out.writeInt(program);
+	out.writeInt(ParameterSnapshot::SIZE);
+
+	for (const auto* parameter : m_parameters)
+	{
+		out.writeString(parameter->getParameterID());
+		out.writeFloat(parameter->convertFrom0to1(parameter->getValue()));
+	}
+}
+
+bool PresetBank::readState(const void* data, int sizeInBytes, int& program) const
+{
+	juce::MemoryInputStream in(data, (size_t)juce::jmax(0, sizeInBytes), false);
+
+	if (sizeInBytes < 16 || in.readInt() != STATE_MAGIC)
+		return false;
+
+	// Later versions only append to the version 1 layout
+	in.readInt();
+	program = in.readInt();
+	const int count = in.readInt();
+
+	ParameterSnapshot snapshot;
+
+	for (int i = 0; i < ParameterSnapshot::SIZE; ++i)
+		snapshot.values[i] = m_parameters[i]->getDefaultValue();
+
+	for (int entry = 0; entry < count && !in.isExhausted(); ++entry)
+	{
+		const auto id = in.readString();
+		const float value = in.readFloat();
+
+		for (int i = 0; i < ParameterSnapshot::SIZE; ++i)
+			if (m_parameters[i]->getParameterID() == id)
+				snapshot.values[i] = m_parameters[i]->convertTo0to1(value);
+	}
+
+	apply(snapshot);
+	return true;
+}
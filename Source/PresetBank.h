@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    Program bank of parameter snapshots, and the binary plugin state.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Normalised value of every parameter, in the order given to PresetBank::init.
+// The processor checks SIZE against its parameter name arrays.
+struct ParameterSnapshot
+{
+	static const int SIZE = 30;
+
+	float values[SIZE] = {};
+};
+
+//==============================================================================
+// Factory presets are converted to snapshots once in init(), so switching
+// programs only sets parameter values, without parsing or allocating.
+//
+// The binary state holds a magic number, a version, the current program and
+// (ID, plain value) pairs. Readers skip unknown IDs and give missing
+// parameters their default, so parameters can be added without a new version.
+// Blobs without the magic number are left to the XML reader.
+class PresetBank
+{
+public:
+	PresetBank() {};
+
+	static const int STATE_MAGIC = 0x5453445a; // "ZDST"
+	static const int STATE_VERSION = 1;
+
+	// Message thread, once, with ParameterSnapshot::SIZE parameter IDs
+	void init(juce::AudioProcessorValueTreeState& apvts, const juce::StringArray& parameterIds);
+
+	int getNumPresets() const { return (int)m_presets.size(); }
+	const juce::String& getName(int index) const { return m_presets[(size_t)index].name; }
+	void setName(int index, const juce::String& name) { m_presets[(size_t)index].name = name; }
+
+	// Sets every parameter that differs from the preset, notifying the host
+	void apply(int index) const;
+	void apply(const ParameterSnapshot& snapshot) const;
+	void capture(ParameterSnapshot& snapshot) const;
+
+	void writeState(juce::MemoryBlock& destData, int program) const;
+
+	// False, without touching any parameter, when data is not a binary state
+	bool readState(const void* data, int sizeInBytes, int& program) const;
+
+private:
+	struct Preset
+	{
+		juce::String name;
+		ParameterSnapshot snapshot;
+	};
+
+	juce::RangedAudioParameter* m_parameters[ParameterSnapshot::SIZE] = {};
+	std::vector<Preset> m_presets;
+};
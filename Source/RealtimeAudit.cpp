@@ -0,0 +1,463 @@
+/*
+  ==============================================================================
+
+    Realtime-safety audit of the audio callback, enabled at build time.
+
+  ==============================================================================
+*/
+
+#include "RealtimeAudit.h"
+
+#if ZAZZ_REALTIME_AUDIT
+ #include <atomic>
+ #include <cstdlib>
+ #include <new>
+
+ #if JUCE_WINDOWS
+  #include <windows.h>
+ #else
+  #include <execinfo.h>
+ #endif
+
+ #if JUCE_LINUX
+  #include <dlfcn.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <pthread.h>
+  #include <semaphore.h>
+  #include <sys/select.h>
+  #include <time.h>
+  #include <unistd.h>
+  #include <cstdarg>
+ #endif
+#endif
+
+//==============================================================================
+#if ZAZZ_REALTIME_AUDIT
+namespace
+{
+	using RealtimeAudit::Kind;
+
+	// Depth of active ScopedCallbacks, and whether a hook further up the
+	// stack of this thread is already handling the call. Plain thread locals
+	// in the executable need no allocation, so hooks can read them.
+	thread_local int t_callbackDepth = 0;
+	thread_local bool t_inHook = false;
+
+	std::atomic<int> g_numViolations{ 0 };
+	RealtimeAudit::Violation g_violations[RealtimeAudit::MAX_VIOLATIONS];
+
+	int captureStack(void** frames, int maxFrames)
+	{
+	#if JUCE_WINDOWS
+		return (int)CaptureStackBackTrace(0, (DWORD)maxFrames, frames, nullptr);
+	#else
+		return backtrace(frames, maxFrames);
+	#endif
+	}
+
+	// The unwinder is loaded by the first backtrace(), which allocates, so
+	// that happens at startup rather than in the first violation
+	const bool g_unwinderLoaded = []
+	{
+		void* frames[1];
+		return captureStack(frames, 1) >= 0;
+	}();
+
+	void record(Kind kind, const char* function)
+	{
+		const int index = g_numViolations.fetch_add(1);
+
+		if (index >= RealtimeAudit::MAX_VIOLATIONS)
+			return;
+
+		auto& violation = g_violations[index];
+		violation.kind = kind;
+		violation.function = function;
+		violation.numFrames = captureStack(violation.frames, RealtimeAudit::MAX_FRAMES);
+	}
+
+	// Held by every hook while it forwards the call. Only the outermost one
+	// records, so operator new does not show up again as malloc, and neither
+	// does anything the recording itself calls.
+	class Hook
+	{
+	public:
+		Hook(Kind kind, const char* function) : m_outer(!t_inHook)
+		{
+			if (!m_outer)
+				return;
+
+			t_inHook = true;
+
+			if (t_callbackDepth > 0)
+				record(kind, function);
+		}
+
+		~Hook()
+		{
+			if (m_outer)
+				t_inHook = false;
+		}
+
+	private:
+		const bool m_outer;
+	};
+}
+
+//==============================================================================
+RealtimeAudit::ScopedCallback::ScopedCallback(bool active) : m_active(active)
+{
+	if (m_active)
+		++t_callbackDepth;
+}
+
+RealtimeAudit::ScopedCallback::~ScopedCallback()
+{
+	if (m_active)
+		--t_callbackDepth;
+}
+
+void RealtimeAudit::checkBoundary(const char* function)
+{
+	const Hook hook(Kind::boundary, function);
+}
+#endif
+
+//==============================================================================
+bool RealtimeAudit::isEnabled()
+{
+	return ZAZZ_REALTIME_AUDIT != 0;
+}
+
+int RealtimeAudit::getNumViolations()
+{
+#if ZAZZ_REALTIME_AUDIT
+	return g_numViolations.load();
+#else
+	return 0;
+#endif
+}
+
+RealtimeAudit::Violation RealtimeAudit::getViolation(int index)
+{
+#if ZAZZ_REALTIME_AUDIT
+	if (index >= 0 && index < juce::jmin(getNumViolations(), MAX_VIOLATIONS))
+		return g_violations[index];
+#else
+	juce::ignoreUnused(index);
+#endif
+
+	return {};
+}
+
+void RealtimeAudit::clear()
+{
+#if ZAZZ_REALTIME_AUDIT
+	g_numViolations.store(0);
+#endif
+}
+
+juce::String RealtimeAudit::describe(const Violation& violation)
+{
+	static const char* kindNames[] = { "allocation", "deallocation", "lock", "system call", "boundary" };
+
+	juce::String text = juce::String(kindNames[(int)violation.kind]) + ": " + violation.function;
+
+#if ZAZZ_REALTIME_AUDIT && !JUCE_WINDOWS
+	char** symbols = backtrace_symbols(violation.frames, violation.numFrames);
+
+	for (int frame = 0; frame < violation.numFrames; ++frame)
+		text << "\n  " << (symbols != nullptr ? juce::String(symbols[frame]) : juce::String::toHexString((juce::pointer_sized_int)violation.frames[frame]));
+
+	std::free(symbols);
+#else
+	for (int frame = 0; frame < violation.numFrames; ++frame)
+		text << "\n  0x" << juce::String::toHexString((juce::pointer_sized_int)violation.frames[frame]);
+#endif
+
+	return text;
+}
+
+//==============================================================================
+// Replacements of the global allocation functions
+#if ZAZZ_REALTIME_AUDIT
+void* operator new(std::size_t size)
+{
+	const Hook hook(Kind::allocation, "operator new");
+
+	if (void* memory = std::malloc(size > 0 ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	const Hook hook(Kind::allocation, "operator new");
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	const Hook hook(Kind::allocation, "operator new");
+	void* memory = nullptr;
+
+   #if JUCE_WINDOWS
+	memory = _aligned_malloc(size > 0 ? size : 1, (size_t)alignment);
+   #else
+	if (posix_memalign(&memory, juce::jmax((size_t)alignment, sizeof(void*)), size > 0 ? size : 1) != 0)
+		memory = nullptr;
+   #endif
+
+	if (memory == nullptr)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (memory == nullptr)
+		return;
+
+	const Hook hook(Kind::deallocation, "operator delete");
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	if (memory == nullptr)
+		return;
+
+	const Hook hook(Kind::deallocation, "operator delete");
+
+   #if JUCE_WINDOWS
+	_aligned_free(memory);
+   #else
+	std::free(memory);
+   #endif
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+#endif
+
+//==============================================================================
+// C library interposition. The allocator forwards to glibc's internal entry
+// points, everything else to the next definition found by the dynamic linker,
+// which is looked up on first use without a static guard.
+#if ZAZZ_REALTIME_AUDIT && JUCE_LINUX
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* memory, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void* memory);
+}
+
+template <typename Function>
+static Function getNext(std::atomic<Function>& next, const char* name)
+{
+	Function function = next.load(std::memory_order_relaxed);
+
+	if (function == nullptr)
+	{
+		function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+		next.store(function, std::memory_order_relaxed);
+	}
+
+	return function;
+}
+
+#define ZAZZ_AUDIT_FORWARD(kind, name, signature, ...) \
+	static std::atomic<signature> next{ nullptr }; \
+	const Hook hook(kind, name); \
+	return getNext(next, name)(__VA_ARGS__)
+
+extern "C"
+{
+	void* malloc(size_t size) noexcept
+	{
+		const Hook hook(Kind::allocation, "malloc");
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) noexcept
+	{
+		const Hook hook(Kind::allocation, "calloc");
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* memory, size_t size) noexcept
+	{
+		const Hook hook(Kind::allocation, "realloc");
+		return __libc_realloc(memory, size);
+	}
+
+	void* memalign(size_t alignment, size_t size) noexcept
+	{
+		const Hook hook(Kind::allocation, "memalign");
+		return __libc_memalign(alignment, size);
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept
+	{
+		const Hook hook(Kind::allocation, "aligned_alloc");
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void** memory, size_t alignment, size_t size) noexcept
+	{
+		const Hook hook(Kind::allocation, "posix_memalign");
+		*memory = __libc_memalign(alignment, size);
+		return *memory != nullptr ? 0 : ENOMEM;
+	}
+
+	void free(void* memory) noexcept
+	{
+		if (memory == nullptr)
+			return;
+
+		const Hook hook(Kind::deallocation, "free");
+		__libc_free(memory);
+	}
+
+	// Taking a lock can wait for a lower priority thread, even when it
+	// usually does not, so every call counts. Try-locks are left alone.
+	int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::lock, "pthread_mutex_lock", int (*)(pthread_mutex_t*), mutex);
+	}
+
+	int pthread_rwlock_rdlock(pthread_rwlock_t* lock) noexcept
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::lock, "pthread_rwlock_rdlock", int (*)(pthread_rwlock_t*), lock);
+	}
+
+	int pthread_rwlock_wrlock(pthread_rwlock_t* lock) noexcept
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::lock, "pthread_rwlock_wrlock", int (*)(pthread_rwlock_t*), lock);
+	}
+
+	int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::lock, "pthread_cond_wait", int (*)(pthread_cond_t*, pthread_mutex_t*), condition, mutex);
+	}
+
+	int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::lock, "pthread_cond_timedwait", int (*)(pthread_cond_t*, pthread_mutex_t*, const struct timespec*), condition, mutex, time);
+	}
+
+	int sem_wait(sem_t* semaphore)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::lock, "sem_wait", int (*)(sem_t*), semaphore);
+	}
+
+	int open(const char* path, int flags, ...)
+	{
+		mode_t mode = 0;
+
+		if ((flags & O_CREAT) != 0)
+		{
+			va_list args;
+			va_start(args, flags);
+			mode = (mode_t)va_arg(args, int);
+			va_end(args);
+		}
+
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "open", int (*)(const char*, int, ...), path, flags, mode);
+	}
+
+	int close(int file)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "close", int (*)(int), file);
+	}
+
+	ssize_t read(int file, void* buffer, size_t count)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "read", ssize_t (*)(int, void*, size_t), file, buffer, count);
+	}
+
+	ssize_t write(int file, const void* buffer, size_t count)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "write", ssize_t (*)(int, const void*, size_t), file, buffer, count);
+	}
+
+	int fsync(int file)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "fsync", int (*)(int), file);
+	}
+
+	int nanosleep(const struct timespec* duration, struct timespec* remaining)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "nanosleep", int (*)(const struct timespec*, struct timespec*), duration, remaining);
+	}
+
+	int clock_nanosleep(clockid_t clock, int flags, const struct timespec* duration, struct timespec* remaining)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "clock_nanosleep", int (*)(clockid_t, int, const struct timespec*, struct timespec*), clock, flags, duration, remaining);
+	}
+
+	int usleep(useconds_t duration)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "usleep", int (*)(useconds_t), duration);
+	}
+
+	int poll(struct pollfd* files, nfds_t count, int timeout)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "poll", int (*)(struct pollfd*, nfds_t, int), files, count, timeout);
+	}
+
+	int select(int count, fd_set* readFiles, fd_set* writeFiles, fd_set* exceptFiles, struct timeval* timeout)
+	{
+		ZAZZ_AUDIT_FORWARD(Kind::systemCall, "select", int (*)(int, fd_set*, fd_set*, fd_set*, struct timeval*), count, readFiles, writeFiles, exceptFiles, timeout);
+	}
+}
+
+#undef ZAZZ_AUDIT_FORWARD
+#endif
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    Realtime-safety audit of the audio callback, enabled at build time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Built with ZAZZ_REALTIME_AUDIT=1, allocations, lock waits and blocking system
+// calls made by a thread while it is inside a ScopedCallback are recorded with
+// the stack they came from. Otherwise ScopedCallback and checkBoundary compile
+// to nothing and no hooks are installed.
+//
+// Hooks replace operator new and delete everywhere. On Linux the C allocator,
+// pthread mutex, rwlock, condition variable and semaphore waits and the file,
+// sleep and poll system calls are interposed as well, which only takes effect
+// in the executable, so the audit is meant for Tools/RealtimeAudit rather than
+// a plugin loaded by a host.
+#ifndef ZAZZ_REALTIME_AUDIT
+ #define ZAZZ_REALTIME_AUDIT 0
+#endif
+
+namespace RealtimeAudit
+{
+	enum class Kind
+	{
+		allocation = 0,
+		deallocation,
+		lock,
+		systemCall,
+		boundary
+	};
+
+	static const int MAX_FRAMES = 32;
+	static const int MAX_VIOLATIONS = 256;
+
+	// What was called, and the return addresses leading to it
+	struct Violation
+	{
+		Kind kind = Kind::allocation;
+		const char* function = "";
+		int numFrames = 0;
+		void* frames[MAX_FRAMES] = {};
+	};
+
+#if ZAZZ_REALTIME_AUDIT
+	// Marks the calling thread as inside the audio callback while it exists.
+	// Inactive ones, for offline renders, nest without effect.
+	class ScopedCallback
+	{
+	public:
+		explicit ScopedCallback(bool active);
+		~ScopedCallback();
+
+	private:
+		const bool m_active;
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedCallback)
+	};
+
+	// prepareToPlay and releaseResources allocate, so they are recorded when a
+	// host calls them from inside the callback
+	void checkBoundary(const char* function);
+#else
+	class ScopedCallback
+	{
+	public:
+		explicit ScopedCallback(bool) {}
+	};
+
+	inline void checkBoundary(const char*) {}
+#endif
+
+	// True in builds with the hooks installed
+	bool isEnabled();
+
+	// Violations since the last clear(), including the ones past MAX_VIOLATIONS
+	// that were counted but not stored
+	int getNumViolations();
+	Violation getViolation(int index);
+	void clear();
+
+	// Kind, function and symbolised stack. Allocates, so only call it outside
+	// of the callback.
+	juce::String describe(const Violation& violation);
+}
@@ -0,0 +1,195 @@
+/*
+  ==============================================================================
+
+    Four-lane float vector used by the channel-parallel DSP kernels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || defined(_M_IX86)
+ #include <emmintrin.h>
+ #define ZAZZ_SIMD_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define ZAZZ_SIMD_NEON 1
+#endif
+
+//==============================================================================
+// One lane per channel. Comparisons return lane masks that are only meant to
+// be passed to select(). Without a supported instruction set this compiles to
+// plain arrays, so kernels written against it build everywhere.
+struct alignas(16) Float4
+{
+	static const int size = 4;
+
+#if ZAZZ_SIMD_SSE2
+	__m128 v;
+
+	static inline Float4 broadcast(float x) { return { _mm_set1_ps(x) }; }
+	static inline Float4 load(const float* p) { return { _mm_load_ps(p) }; }
+	inline void store(float* p) const { _mm_store_ps(p, v); }
+
+	friend inline Float4 operator+ (Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	friend inline Float4 operator- (Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	friend inline Float4 operator* (Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+	friend inline Float4 operator/ (Float4 a, Float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+	friend inline Float4 operator- (Float4 a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+
+	static inline Float4 min(Float4 a, Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+	static inline Float4 max(Float4 a, Float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+	static inline Float4 abs(Float4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+	static inline Float4 sqrt(Float4 a) { return { _mm_sqrt_ps(a.v) }; }
+
+	static inline Float4 greaterThan(Float4 a, Float4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	static inline Float4 greaterThanOrEqual(Float4 a, Float4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+	static inline Float4 select(Float4 mask, Float4 a, Float4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+
+	// Bit-level helpers, exponent and mantissa are only valid for positive
+	// normal floats. round() assumes the default MXCSR rounding mode.
+	static inline Float4 round(Float4 a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; }
+	static inline Float4 getExponent(Float4 a) { return { _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(a.v), 23), _mm_set1_epi32(127))) }; }
+	static inline Float4 getMantissa(Float4 a) { return { _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(_mm_castps_si128(a.v), _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000))) }; }
+	static inline Float4 ldexp(Float4 a, Float4 n) { return { _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(a.v), _mm_slli_epi32(_mm_cvtps_epi32(n.v), 23))) }; }
+
+	// Rows to columns: lane i of a, b, c and d becomes a, b, c and d of row i
+	static inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+#elif ZAZZ_SIMD_NEON
+	float32x4_t v;
+
+	static inline Float4 broadcast(float x) { return { vdupq_n_f32(x) }; }
+	static inline Float4 load(const float* p) { return { vld1q_f32(p) }; }
+	inline void store(float* p) const { vst1q_f32(p, v); }
+
+	friend inline Float4 operator+ (Float4 a, Float4 b) { return { vaddq_f32(a.v, b.v) }; }
+	friend inline Float4 operator- (Float4 a, Float4 b) { return { vsubq_f32(a.v, b.v) }; }
+	friend inline Float4 operator* (Float4 a, Float4 b) { return { vmulq_f32(a.v, b.v) }; }
+	friend inline Float4 operator/ (Float4 a, Float4 b) { return { vdivq_f32(a.v, b.v) }; }
+	friend inline Float4 operator- (Float4 a) { return { vnegq_f32(a.v) }; }
+
+	static inline Float4 min(Float4 a, Float4 b) { return { vminq_f32(a.v, b.v) }; }
+	static inline Float4 max(Float4 a, Float4 b) { return { vmaxq_f32(a.v, b.v) }; }
+	static inline Float4 abs(Float4 a) { return { vabsq_f32(a.v) }; }
+	static inline Float4 sqrt(Float4 a) { return { vsqrtq_f32(a.v) }; }
+
+	static inline Float4 greaterThan(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)) }; }
+	static inline Float4 greaterThanOrEqual(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v)) }; }
+	static inline Float4 select(Float4 mask, Float4 a, Float4 b) { return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) }; }
+
+	static inline Float4 round(Float4 a) { return { vrndnq_f32(a.v) }; }
+	static inline Float4 getExponent(Float4 a) { return { vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_f32(a.v), 23)), vdupq_n_s32(127))) }; }
+	static inline Float4 getMantissa(Float4 a) { return { vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000))) }; }
+	static inline Float4 ldexp(Float4 a, Float4 n) { return { vreinterpretq_f32_s32(vaddq_s32(vreinterpretq_s32_f32(a.v), vshlq_n_s32(vcvtnq_s32_f32(n.v), 23))) }; }
+
+	static inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d)
+	{
+		const float32x4x2_t ab = vtrnq_f32(a.v, b.v);
+		const float32x4x2_t cd = vtrnq_f32(c.v, d.v);
+		a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+		b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+		c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+	}
+#else
+	float v[4];
+
+	static inline Float4 broadcast(float x) { return { { x, x, x, x } }; }
+	static inline Float4 load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+	inline void store(float* p) const { for (int i = 0; i < size; ++i) p[i] = v[i]; }
+
+	template <typename Function>
+	static inline Float4 map(Float4 a, Float4 b, Function f) { return { { f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3]) } }; }
+
+	friend inline Float4 operator+ (Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x + y; }); }
+	friend inline Float4 operator- (Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x - y; }); }
+	friend inline Float4 operator* (Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x * y; }); }
+	friend inline Float4 operator/ (Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x / y; }); }
+	friend inline Float4 operator- (Float4 a) { return { { -a.v[0], -a.v[1], -a.v[2], -a.v[3] } }; }
+
+	static inline Float4 min(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return fminf(x, y); }); }
+	static inline Float4 max(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return fmaxf(x, y); }); }
+	static inline Float4 abs(Float4 a) { return { { fabsf(a.v[0]), fabsf(a.v[1]), fabsf(a.v[2]), fabsf(a.v[3]) } }; }
+	static inline Float4 sqrt(Float4 a) { return { { sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3]) } }; }
+
+	// Masks are 1.0f (true) or 0.0f (false)
+	static inline Float4 greaterThan(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x > y ? 1.0f : 0.0f; }); }
+	static inline Float4 greaterThanOrEqual(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x >= y ? 1.0f : 0.0f; }); }
+	static inline Float4 select(Float4 mask, Float4 a, Float4 b)
+	{
+		return { { mask.v[0] != 0.0f ? a.v[0] : b.v[0], mask.v[1] != 0.0f ? a.v[1] : b.v[1],
+		           mask.v[2] != 0.0f ? a.v[2] : b.v[2], mask.v[3] != 0.0f ? a.v[3] : b.v[3] } };
+	}
+
+	static inline Float4 round(Float4 a) { return { { nearbyintf(a.v[0]), nearbyintf(a.v[1]), nearbyintf(a.v[2]), nearbyintf(a.v[3]) } }; }
+
+	static inline Float4 getExponent(Float4 a)
+	{
+		Float4 result;
+		for (int i = 0; i < size; ++i)
+			result.v[i] = (float)((int)(toBits(a.v[i]) >> 23) - 127);
+		return result;
+	}
+
+	static inline Float4 getMantissa(Float4 a)
+	{
+		Float4 result;
+		for (int i = 0; i < size; ++i)
+			result.v[i] = fromBits((toBits(a.v[i]) & 0x007fffff) | 0x3f800000);
+		return result;
+	}
+
+	static inline Float4 ldexp(Float4 a, Float4 n)
+	{
+		Float4 result;
+		for (int i = 0; i < size; ++i)
+			result.v[i] = fromBits(toBits(a.v[i]) + ((uint32_t)(int)nearbyintf(n.v[i]) << 23));
+		return result;
+	}
+
+	static inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d)
+	{
+		Float4* rows[size] = { &a, &b, &c, &d };
+
+		for (int i = 0; i < size; ++i)
+			for (int j = i + 1; j < size; ++j)
+				std::swap(rows[i]->v[j], rows[j]->v[i]);
+	}
+#endif
+
+	static inline Float4 zero() { return broadcast(0.0f); }
+
+	static inline uint32_t toBits(float x) { uint32_t bits; std::memcpy(&bits, &x, sizeof(bits)); return bits; }
+	static inline float fromBits(uint32_t bits) { float x; std::memcpy(&x, &bits, sizeof(x)); return x; }
+
+	// Lane-wise powf, for the few operations that have no vector instruction
+	static inline Float4 pow(Float4 x, float exponent)
+	{
+		alignas(16) float lanes[size];
+		x.store(lanes);
+
+		for (int i = 0; i < size; ++i)
+			lanes[i] = powf(lanes[i], exponent);
+
+		return load(lanes);
+	}
+
+	// Lane-wise powf with an exponent per lane
+	static inline Float4 pow(Float4 x, Float4 exponent)
+	{
+		alignas(16) float lanes[size];
+		alignas(16) float exponents[size];
+		x.store(lanes);
+		exponent.store(exponents);
+
+		for (int i = 0; i < size; ++i)
+			lanes[i] = powf(lanes[i], exponents[i]);
+
+		return load(lanes);
+	}
+};
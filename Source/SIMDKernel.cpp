@@ -0,0 +1,722 @@
+/*
+  ==============================================================================
+
+    Channel-parallel version of the DistortionAudioProcessor DSP loop.
+
+  ==============================================================================
+*/
+
+#include "SIMDKernel.h"
+
+//==============================================================================
+bool SIMDKernel::isSupported()
+{
+#if ZAZZ_SIMD_SSE2
+	return juce::SystemStats::hasSSE2();
+#elif ZAZZ_SIMD_NEON
+	return true;
+#else
+	return false;
+#endif
+}
+
+//==============================================================================
+// Samples are interleaved into a small stack buffer so every lane load is a
+// single aligned vector load
+static const int CHUNK_SIZE = Oversampler::MAX_BLOCK_SIZE;
+
+static inline void interleave(float* const* channels, int numChannels, int start, int count, float* interleaved)
+{
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		const float* channelBuffer = channels[channel] + start;
+
+		for (int sample = 0; sample < count; ++sample)
+			interleaved[sample * Float4::size + channel] = channelBuffer[sample];
+	}
+}
+
+static inline void deinterleave(const float* interleaved, int numChannels, int start, int count, float* const* channels)
+{
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		float* channelBuffer = channels[channel] + start;
+
+		for (int sample = 0; sample < count; ++sample)
+			channelBuffer[sample] = interleaved[sample * Float4::size + channel];
+	}
+}
+
+//==============================================================================
+// One K-weighting biquad, same operations as KWeighting::processStage
+struct WeightingStage
+{
+	WeightingStage(const KWeighting::Coefficients& c)
+		: b0(Float4::broadcast(c.b0))
+		, b1(Float4::broadcast(c.b1))
+		, b2(Float4::broadcast(c.b2))
+		, a1(Float4::broadcast(c.a1))
+		, a2(Float4::broadcast(c.a2))
+	{
+	}
+
+	inline Float4 process(Float4 in, Float4& z1, Float4& z2) const
+	{
+		const Float4 out = in * b0 + z1;
+		z1 = in * b1 + z2 - a1 * out;
+		z2 = in * b2 - a2 * out;
+		return out;
+	}
+
+	const Float4 b0;
+	const Float4 b1;
+	const Float4 b2;
+	const Float4 a1;
+	const Float4 a2;
+};
+
+struct KernelConstants
+{
+	KernelConstants(const KernelParameters& params)
+		: gainInterval(params.gainInterval)
+		, gainIntervalInverse(Float4::broadcast(1.0f / (float)params.gainInterval))
+		, dynamics(Float4::broadcast(params.dynamics))
+		, wetGain(Float4::broadcast(params.wetGain))
+		, dryGain(Float4::broadcast(params.dryGain))
+		, clipLevel(Float4::broadcast(params.clipLevel))
+		, minusClipLevel(Float4::broadcast(-params.clipLevel))
+		, attackCoef(Float4::broadcast(params.attackCoef))
+		, releaseCoef(Float4::broadcast(params.releaseCoef))
+		, releaseCoefInverse(Float4::broadcast(1.0f - params.releaseCoef))
+		, a0(Float4::broadcast(params.a0))
+		, a1(Float4::broadcast(params.a1))
+		, a2(Float4::broadcast(params.a2))
+		, b1(Float4::broadcast(params.b1))
+		, b2(Float4::broadcast(params.b2))
+		, prewarp(params.prewarp)
+		, cutoffOctave(Float4::broadcast(params.cutoffOctave))
+		, modulationDepth(Float4::broadcast(params.modulationDepth))
+		, svfK(Float4::broadcast(params.svfK))
+		, windowLength(params.windowLength)
+		, windowCapacity(params.windowCapacity)
+		, windowInverse(Float4::broadcast(1.0f / (float)params.windowLength))
+		, shelf(params.shelf)
+		, highPass(params.highPass)
+	{
+	}
+
+	const Float4 zero = Float4::zero();
+	const Float4 one = Float4::broadcast(1.0f);
+	const Float4 loudnessThreshold = Float4::broadcast(0.001f);
+
+	const int gainInterval;
+	const Float4 gainIntervalInverse;
+	const Float4 dynamics;
+	const Float4 wetGain;
+	const Float4 dryGain;
+	const Float4 clipLevel;
+	const Float4 minusClipLevel;
+	const Float4 attackCoef;
+	const Float4 releaseCoef;
+	const Float4 releaseCoefInverse;
+	const Float4 a0;
+	const Float4 a1;
+	const Float4 a2;
+	const Float4 b1;
+	const Float4 b2;
+	const PrewarpTable* prewarp;
+	const Float4 cutoffOctave;
+	const Float4 modulationDepth;
+	const Float4 svfK;
+	const int windowLength;
+	const int windowCapacity;
+	const Float4 windowInverse;
+	const WeightingStage shelf;
+	const WeightingStage highPass;
+};
+
+// Same operations, in the same order, as EnvelopeFollower::process
+static inline Float4 followEnvelope(const KernelConstants& k, Float4 in, Float4& envelope, Float4& envelope1)
+{
+	const Float4 inAbs = Float4::abs(in);
+	envelope1 = Float4::max(inAbs, k.releaseCoef * envelope1 + k.releaseCoefInverse * inAbs);
+	return envelope = k.attackCoef * (envelope - envelope1) + envelope1;
+}
+
+template <WaveshaperAccuracy accuracy>
+static inline Float4 distort(const KernelConstants& k, const Waveshaper& waveshaper, Float4 in)
+{
+	const Float4 magnitude = waveshaper.processMagnitude<accuracy>(Float4::abs(in));
+	return Float4::select(Float4::greaterThanOrEqual(in, k.zero), magnitude, -magnitude);
+}
+
+// Same operations, in the same order, as BiquadLowPassFilter::process
+static inline Float4 lowPass(const KernelConstants& k, Float4 in, Float4& z1, Float4& z2)
+{
+	const Float4 out = in * k.a0 + z1;
+	z1 = in * k.a1 + z2 - k.b1 * out;
+	z2 = in * k.a2 - k.b2 * out;
+	return out;
+}
+
+// Control point, same operations as the scalar loop. Returns the gain step
+// that ramps to the new compensation over the next interval.
+static inline Float4 updateGain(const KernelConstants& k, Float4 dynamics, Float4 inputPeak, Float4 outputPeak, Float4 gain, ChannelGroupState& state)
+{
+	const Float4 inputLoudness = followEnvelope(k, inputPeak, state.inputEnvelope, state.inputEnvelope1);
+	const Float4 outputLoudness = followEnvelope(k, outputPeak, state.outputEnvelope, state.outputEnvelope1);
+
+	// Get gain compensation, 1 - (1 - g) * d and 1 + (g - 1) * d are the same value
+	const Float4 ratio = inputLoudness / outputLoudness;
+	const Float4 gainCompensation = Float4::select(Float4::greaterThan(outputLoudness, k.loudnessThreshold), k.one + (ratio - k.one) * dynamics, k.one);
+
+	return (gainCompensation - gain) * k.gainIntervalInverse;
+}
+
+// Both K-weighting stages, z holds z1 and z2 of each
+static inline Float4 weight(const KernelConstants& k, Float4 in, Float4* z)
+{
+	return k.highPass.process(k.shelf.process(in, z[0], z[1]), z[2], z[3]);
+}
+
+// Level of one gain interval, from its peak or its sum of squares. The RMS
+// detectors average the interval energies over the window.
+template <DetectorMode detector>
+static inline Float4 getLevel(const KernelConstants& k, Float4 accumulated, LoudnessWindowState<Float4>& window, Float4* ring)
+{
+	if (detector == DetectorMode::peak)
+		return accumulated;
+
+	const Float4 sum = LoudnessWindow::push(window, ring, k.windowCapacity, k.windowLength, accumulated * k.gainIntervalInverse);
+	return Float4::sqrt(Float4::max(sum * k.windowInverse, k.zero));
+}
+
+// Mix and Dynamics of every lane, the same for all channels. index is the
+// sample within the ramps.
+template <bool ramped>
+struct ChannelGains
+{
+	ChannelGains(const KernelConstants& k, const KernelRamps* ramps)
+		: k(k)
+		, ramps(ramps)
+	{
+	}
+
+	inline Float4 getDynamics(int index) const { return ramped ? Float4::broadcast(ramps->dynamics[index]) : k.dynamics; }
+	inline Float4 getWetGain(int index) const { return ramped ? Float4::broadcast(ramps->wetGain[index]) : k.wetGain; }
+	inline Float4 getDryGain(int index) const { return ramped ? Float4::broadcast(ramps->dryGain[index]) : k.dryGain; }
+
+	const KernelConstants& k;
+	const KernelRamps* ramps;
+};
+
+// Channels are clipped as they are written, bands only once they are summed
+static inline void write(const KernelConstants& k, Float4 value, float* out, int sample)
+{
+	Float4::min(Float4::max(value, k.minusClipLevel), k.clipLevel).store(out + sample * Float4::size);
+}
+
+static inline void write(const KernelConstants&, Float4 value, Float4* out, int sample)
+{
+	out[sample] = value;
+}
+
+// Gain compensation at control rate. The level of each gain interval drives
+// the envelope followers, and the gain ramps linearly to the new value over
+// the next interval, so the per-sample loop has no branches or divisions.
+// Writes count mixed frames to out, see write(). out may be wet.
+//
+// With KernelFlags::modulated wet is unfiltered. The state variable filter runs
+// here, its cutoff ramping to the input envelope target of each control point.
+template <DetectorMode detector, int flags, typename Gains, typename Output>
+static inline void compensateWithDetector(const KernelConstants& k, const Gains& gains, int start, int count, const Float4* wet, const Float4* dry, ChannelGroupState& state, Output* out)
+{
+	const bool mixed = (flags & KernelFlags::mixed) != 0;
+	const bool modulated = (flags & KernelFlags::modulated) != 0;
+
+	// Without dynamics the gain is 1. The envelopes keep their last values
+	// and the gain restarts from 1 when Dynamics comes back.
+	if ((flags & KernelFlags::dynamics) == 0)
+	{
+		for (int sample = 0; sample < count; ++sample)
+		{
+			const Float4 wetGain = gains.getWetGain(start + sample);
+			const Float4 inVolume = mixed ? wetGain * wet[sample] + gains.getDryGain(start + sample) * dry[sample] : wetGain * wet[sample];
+			write(k, inVolume, out, sample);
+		}
+
+		state.inputPeak = k.zero;
+		state.outputPeak = k.zero;
+		state.gain = k.one;
+		state.gainStep = k.zero;
+		state.gainPhase = 0;
+		return;
+	}
+
+	// Peaks, or sums of squares for the RMS detectors
+	Float4 inputLevel = state.inputPeak;
+	Float4 outputLevel = state.outputPeak;
+	Float4 gain = state.gain;
+	Float4 gainStep = state.gainStep;
+	Float4 svfZ1 = state.svfZ1;
+	Float4 svfZ2 = state.svfZ2;
+	Float4 cutoffOffset = state.cutoffOffset;
+	Float4 cutoffStep = state.cutoffStep;
+	Float4 inputWeighting[4] = { state.inputWeighting[0], state.inputWeighting[1], state.inputWeighting[2], state.inputWeighting[3] };
+	Float4 outputWeighting[4] = { state.outputWeighting[0], state.outputWeighting[1], state.outputWeighting[2], state.outputWeighting[3] };
+
+	for (int sample = 0; sample < count;)
+	{
+		const int run = juce::jmin(k.gainInterval - state.gainPhase, count - sample);
+
+		for (const int end = sample + run; sample < end; ++sample)
+		{
+			const Float4 wetGain = gains.getWetGain(start + sample);
+			const Float4 dryGain = gains.getDryGain(start + sample);
+
+			Float4 inWet = wet[sample];
+
+			if (modulated)
+			{
+				cutoffOffset = cutoffOffset + cutoffStep;
+				const Float4 g = k.prewarp->lookup(k.cutoffOctave + cutoffOffset);
+				inWet = StateVariableFilter::processLowPass(inWet, g, k.svfK, svfZ1, svfZ2);
+			}
+
+			if (detector == DetectorMode::peak)
+			{
+				inputLevel = Float4::max(inputLevel, Float4::abs(dry[sample]));
+				outputLevel = Float4::max(outputLevel, Float4::abs(inWet));
+			}
+			else
+			{
+				const Float4 inputDetected = (detector == DetectorMode::kWeighted) ? weight(k, dry[sample], inputWeighting) : dry[sample];
+				const Float4 outputDetected = (detector == DetectorMode::kWeighted) ? weight(k, inWet, outputWeighting) : inWet;
+				inputLevel = inputLevel + inputDetected * inputDetected;
+				outputLevel = outputLevel + outputDetected * outputDetected;
+			}
+
+			gain = gain + gainStep;
+
+			// Apply volume and mix
+			const Float4 inVolume = mixed ? wetGain * inWet * gain + dryGain * dry[sample] : wetGain * inWet * gain;
+
+			write(k, inVolume, out, sample);
+		}
+
+		state.gainPhase += run;
+
+		if (state.gainPhase < k.gainInterval)
+			break;
+
+		const Float4 dynamics = gains.getDynamics(start + sample - 1);
+		const Float4 inputPeak = getLevel<detector>(k, inputLevel, state.inputWindow, state.history);
+		const Float4 outputPeak = getLevel<detector>(k, outputLevel, state.outputWindow, state.history + k.windowCapacity);
+		gainStep = updateGain(k, dynamics, inputPeak, outputPeak, gain, state);
+		inputLevel = k.zero;
+		outputLevel = k.zero;
+		state.gainPhase = 0;
+
+		// updateGain left the new input loudness in the envelope
+		if (modulated)
+			cutoffStep = (k.modulationDepth * state.inputEnvelope - cutoffOffset) * k.gainIntervalInverse;
+	}
+
+	state.inputPeak = inputLevel;
+	state.outputPeak = outputLevel;
+	state.gain = gain;
+	state.gainStep = gainStep;
+	state.svfZ1 = svfZ1;
+	state.svfZ2 = svfZ2;
+	state.cutoffOffset = cutoffOffset;
+	state.cutoffStep = cutoffStep;
+	std::copy(inputWeighting, inputWeighting + 4, state.inputWeighting);
+	std::copy(outputWeighting, outputWeighting + 4, state.outputWeighting);
+}
+
+// Resolves the detector, which only matters with dynamics
+template <int flags, typename Gains, typename Output>
+static inline void compensateAndMix(const KernelConstants& k, const Gains& gains, int start, int count, const Float4* wet, const Float4* dry, ChannelGroupState& state, Output* out, DetectorMode detector)
+{
+	if ((flags & KernelFlags::dynamics) == 0 || detector == DetectorMode::peak)
+		compensateWithDetector<DetectorMode::peak, flags>(k, gains, start, count, wet, dry, state, out);
+	else if (detector == DetectorMode::rms)
+		compensateWithDetector<DetectorMode::rms, flags>(k, gains, start, count, wet, dry, state, out);
+	else
+		compensateWithDetector<DetectorMode::kWeighted, flags>(k, gains, start, count, wet, dry, state, out);
+}
+
+// Shaper and low pass filter of one frame. An identity shaper is skipped, and
+// the biquad is skipped when the state variable filter takes its place.
+template <WaveshaperAccuracy accuracy, int flags>
+static inline Float4 shapeAndFilter(const KernelConstants& k, const Waveshaper& waveshaper, Float4 in, AntiderivativeHistory<Float4>& history, Float4& z1, Float4& z2)
+{
+	Float4 shaped = in;
+
+	if ((flags & KernelFlags::identity) == 0)
+		shaped = (accuracy == WaveshaperAccuracy::antiderivative) ? waveshaper.processAntiderivative(in, history) : distort<accuracy>(k, waveshaper, in);
+
+	return ((flags & KernelFlags::modulated) != 0) ? shaped : lowPass(k, shaped, z1, z2);
+}
+
+//==============================================================================
+// Arguments of one kernel call
+struct KernelCall
+{
+	float* const* channels;
+	int numChannels;
+	int numSamples;
+	const KernelParameters& params;
+	const KernelRamps* ramps;
+	const Waveshaper& waveshaper;
+	Oversampler* oversampler;
+	Oversampler::State* oversamplerState;
+	ChannelGroupState& state;
+};
+
+template <WaveshaperAccuracy accuracy, bool ramped, int flags>
+static void processChannels(const KernelCall& call)
+{
+	jassert(call.numChannels <= Float4::size);
+
+	alignas(16) float interleaved[CHUNK_SIZE * Float4::size] = {};
+	Float4 dry[CHUNK_SIZE];
+	Float4 wet[CHUNK_SIZE];
+	const KernelConstants k(call.params);
+	const ChannelGains<ramped> gains(k, call.ramps);
+	auto& state = call.state;
+
+	// Keep filter and shaper state in registers for the whole block
+	Float4 z1 = state.z1;
+	Float4 z2 = state.z2;
+	auto history = state.shaperHistory;
+
+	if (accuracy == WaveshaperAccuracy::antiderivative)
+		call.waveshaper.updateHistory(history);
+
+	for (int start = 0; start < call.numSamples; start += CHUNK_SIZE)
+	{
+		const int count = juce::jmin(CHUNK_SIZE, call.numSamples - start);
+
+		// Unused lanes stay silent
+		interleave(call.channels, call.numChannels, start, count, interleaved);
+
+		for (int sample = 0; sample < count; ++sample)
+		{
+			dry[sample] = Float4::load(interleaved + sample * Float4::size);
+			wet[sample] = shapeAndFilter<accuracy, flags>(k, call.waveshaper, dry[sample], history, z1, z2);
+		}
+
+		compensateAndMix<flags>(k, gains, start, count, wet, dry, state, interleaved, call.params.detector);
+
+		deinterleave(interleaved, call.numChannels, start, count, call.channels);
+	}
+
+	state.z1 = z1;
+	state.z2 = z2;
+	state.shaperHistory = history;
+}
+
+// Distortion and low pass filter run at the oversampled rate, the envelope
+// followers and the mix at the host rate on the latency compensated input
+template <WaveshaperAccuracy accuracy, bool ramped, int flags>
+static void processChannelsOversampled(const KernelCall& call)
+{
+	jassert(call.numChannels <= Float4::size);
+
+	alignas(16) float interleaved[CHUNK_SIZE * Float4::size] = {};
+	Float4 dry[CHUNK_SIZE];
+	Float4 wet[CHUNK_SIZE];
+	const KernelConstants k(call.params);
+	const ChannelGains<ramped> gains(k, call.ramps);
+	auto& oversampler = *call.oversampler;
+	auto& oversamplerState = *call.oversamplerState;
+	auto& state = call.state;
+	const int factor = oversampler.getFactor();
+
+	Float4 z1 = state.z1;
+	Float4 z2 = state.z2;
+	auto history = state.shaperHistory;
+
+	if (accuracy == WaveshaperAccuracy::antiderivative)
+		call.waveshaper.updateHistory(history);
+
+	for (int start = 0; start < call.numSamples; start += CHUNK_SIZE)
+	{
+		const int count = juce::jmin(CHUNK_SIZE, call.numSamples - start);
+
+		interleave(call.channels, call.numChannels, start, count, interleaved);
+
+		for (int sample = 0; sample < count; ++sample)
+			wet[sample] = Float4::load(interleaved + sample * Float4::size);
+
+		oversampler.delayDry(oversamplerState, wet, dry, count);
+
+		// Nonlinear stage
+		Float4* oversampled = oversampler.upsample(oversamplerState, wet, count);
+
+		for (int sample = 0; sample < count * factor; ++sample)
+			oversampled[sample] = shapeAndFilter<accuracy, flags>(k, call.waveshaper, oversampled[sample], history, z1, z2);
+
+		oversampler.downsample(oversamplerState, wet, count);
+
+		// Gain compensation and mix
+		compensateAndMix<flags>(k, gains, start, count, wet, dry, state, interleaved, call.params.detector);
+
+		deinterleave(interleaved, call.numChannels, start, count, call.channels);
+	}
+
+	state.z1 = z1;
+	state.z2 = z2;
+	state.shaperHistory = history;
+}
+
+//==============================================================================
+// Resolve oversampling, shaper, ramping and flags once per block
+template <bool oversampled, WaveshaperAccuracy accuracy, bool ramped, int flags>
+static void run(const KernelCall& call)
+{
+	if (oversampled)
+		processChannelsOversampled<accuracy, ramped, flags>(call);
+	else
+		processChannels<accuracy, ramped, flags>(call);
+}
+
+template <bool oversampled, bool ramped, int flags>
+static void processWithShaper(const KernelCall& call)
+{
+	// With an identity shaper the tier is unused, so it maps to one kernel
+	const bool identity = (flags & KernelFlags::identity) != 0;
+
+	switch (call.waveshaper.getAccuracy())
+	{
+	case WaveshaperAccuracy::approximate:
+		run<oversampled, identity ? WaveshaperAccuracy::exact : WaveshaperAccuracy::approximate, ramped, flags>(call);
+		break;
+	case WaveshaperAccuracy::table:
+		run<oversampled, identity ? WaveshaperAccuracy::exact : WaveshaperAccuracy::table, ramped, flags>(call);
+		break;
+	case WaveshaperAccuracy::antiderivative:
+		run<oversampled, identity ? WaveshaperAccuracy::exact : WaveshaperAccuracy::antiderivative, ramped, flags>(call);
+		break;
+	default:
+		run<oversampled, WaveshaperAccuracy::exact, ramped, flags>(call);
+		break;
+	}
+}
+
+template <bool oversampled>
+static void processWithFlags(const KernelCall& call)
+{
+	const int flags = KernelFlags::get(call.params, call.ramps, call.waveshaper.getExponent());
+
+	if (call.ramps != nullptr)
+	{
+		switch (flags & (KernelFlags::identity | KernelFlags::modulated))
+		{
+		case 0: processWithShaper<oversampled, true, KernelFlags::all>(call); break;
+		case 4: processWithShaper<oversampled, true, KernelFlags::all | 4>(call); break;
+		case 8: processWithShaper<oversampled, true, KernelFlags::all | 8>(call); break;
+		default: processWithShaper<oversampled, true, KernelFlags::all | 12>(call); break;
+		}
+
+		return;
+	}
+
+	// Modulated always comes with dynamics
+	switch (flags)
+	{
+	case 0: processWithShaper<oversampled, false, 0>(call); break;
+	case 1: processWithShaper<oversampled, false, 1>(call); break;
+	case 2: processWithShaper<oversampled, false, 2>(call); break;
+	case 3: processWithShaper<oversampled, false, 3>(call); break;
+	case 4: processWithShaper<oversampled, false, 4>(call); break;
+	case 5: processWithShaper<oversampled, false, 5>(call); break;
+	case 6: processWithShaper<oversampled, false, 6>(call); break;
+	case 7: processWithShaper<oversampled, false, 7>(call); break;
+	case 9: processWithShaper<oversampled, false, 9>(call); break;
+	case 11: processWithShaper<oversampled, false, 11>(call); break;
+	case 13: processWithShaper<oversampled, false, 13>(call); break;
+	default: processWithShaper<oversampled, false, 15>(call); break;
+	}
+}
+
+//==============================================================================
+// Multiband kernel, lanes are channels in the crossover and bands everywhere
+// else
+struct BandConstants
+{
+	BandConstants(const BandParameters& params)
+		: exponent(Float4::load(params.exponent))
+		, dynamics(Float4::load(params.dynamics))
+		, wetGain(Float4::load(params.wetGain))
+		, dryGain(Float4::load(params.dryGain))
+		, mix(Float4::load(params.mix))
+		, dryOffset(Float4::load(params.dryOffset))
+	{
+	}
+
+	const Float4 exponent;
+	const Float4 dynamics;
+	const Float4 wetGain;
+	const Float4 dryGain;
+	const Float4 mix;
+	const Float4 dryOffset;
+};
+
+// Mix and Dynamics of every band. Band Dynamics replaces the global ramp and
+// follows its smoother at control rate. The global wet and dry ramps are
+// scaled by the band Mix, as wet * mix and 1 - (1 - dry) * mix.
+template <bool ramped>
+struct BandGains
+{
+	BandGains(const BandConstants& band, const KernelRamps* ramps)
+		: band(band)
+		, ramps(ramps)
+	{
+	}
+
+	inline Float4 getDynamics(int) const { return band.dynamics; }
+	inline Float4 getWetGain(int index) const { return ramped ? Float4::broadcast(ramps->wetGain[index]) * band.mix : band.wetGain; }
+	inline Float4 getDryGain(int index) const { return ramped ? Float4::broadcast(ramps->dryGain[index]) * band.mix + band.dryOffset : band.dryGain; }
+
+	const BandConstants& band;
+	const KernelRamps* ramps;
+};
+
+// The table holds a single exponent, so it is not used here
+template <WaveshaperAccuracy accuracy>
+static inline Float4 distortBands(const KernelConstants& k, const BandConstants& band, Float4 in)
+{
+	const Float4 inAbs = Float4::abs(in);
+	const Float4 magnitude = (accuracy == WaveshaperAccuracy::exact) ? Float4::pow(inAbs, band.exponent) : Waveshaper::powApproximate(inAbs, band.exponent);
+	return Float4::select(Float4::greaterThanOrEqual(in, k.zero), magnitude, -magnitude);
+}
+
+// Arguments of one multiband call
+struct BandCall
+{
+	float* const* channels;
+	int numChannels;
+	int numSamples;
+	const KernelParameters& params;
+	const BandParameters& bandParams;
+	const KernelRamps* ramps;
+	const Crossover& crossover;
+	Crossover::State& crossoverState;
+	ChannelGroupState* bandState;
+};
+
+// Gain compensation always runs, as the bands have a Dynamics each
+template <WaveshaperAccuracy accuracy, bool ramped, int flags>
+static void processBands(const BandCall& call)
+{
+	static_assert(Crossover::MAX_BANDS == Float4::size, "Bands are transposed into lanes");
+	jassert(call.numChannels <= Float4::size);
+
+	alignas(16) float interleaved[CHUNK_SIZE * Float4::size] = {};
+	Float4 dry[Float4::size][CHUNK_SIZE];
+	Float4 wet[Float4::size][CHUNK_SIZE];
+	const KernelConstants k(call.params);
+	const BandConstants band(call.bandParams);
+	const BandGains<ramped> gains(band, call.ramps);
+	const int numChannels = call.numChannels;
+
+	// Unused channels add silence to the sum
+	for (int channel = numChannels; channel < Float4::size; ++channel)
+		for (int sample = 0; sample < CHUNK_SIZE; ++sample)
+			wet[channel][sample] = k.zero;
+
+	for (int start = 0; start < call.numSamples; start += CHUNK_SIZE)
+	{
+		const int count = juce::jmin(CHUNK_SIZE, call.numSamples - start);
+
+		interleave(call.channels, numChannels, start, count, interleaved);
+
+		// Split, then turn the lanes from channels into bands
+		for (int sample = 0; sample < count; ++sample)
+		{
+			Float4 bands[Crossover::MAX_BANDS];
+			call.crossover.split(call.crossoverState, Float4::load(interleaved + sample * Float4::size), bands);
+			Float4::transpose(bands[0], bands[1], bands[2], bands[3]);
+
+			for (int channel = 0; channel < Float4::size; ++channel)
+				dry[channel][sample] = bands[channel];
+		}
+
+		// Every band of a channel in one pass
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			auto& state = call.bandState[channel];
+			Float4 z1 = state.z1;
+			Float4 z2 = state.z2;
+
+			for (int sample = 0; sample < count; ++sample)
+			{
+				const Float4 shaped = distortBands<accuracy>(k, band, dry[channel][sample]);
+				wet[channel][sample] = ((flags & KernelFlags::modulated) != 0) ? shaped : lowPass(k, shaped, z1, z2);
+			}
+
+			state.z1 = z1;
+			state.z2 = z2;
+
+			compensateAndMix<flags>(k, gains, start, count, wet[channel], dry[channel], state, wet[channel], call.params.detector);
+		}
+
+		// Back to channels, sum the bands and clip
+		for (int sample = 0; sample < count; ++sample)
+		{
+			Float4 band0 = wet[0][sample];
+			Float4 band1 = wet[1][sample];
+			Float4 band2 = wet[2][sample];
+			Float4 band3 = wet[3][sample];
+			Float4::transpose(band0, band1, band2, band3);
+
+			const Float4 sum = band0 + band1 + band2 + band3;
+			Float4::min(Float4::max(sum, k.minusClipLevel), k.clipLevel).store(interleaved + sample * Float4::size);
+		}
+
+		deinterleave(interleaved, numChannels, start, count, call.channels);
+	}
+}
+
+template <WaveshaperAccuracy accuracy, bool ramped>
+static void processBandsWithFilter(const BandCall& call)
+{
+	if (call.params.prewarp != nullptr)
+		processBands<accuracy, ramped, KernelFlags::all | KernelFlags::modulated>(call);
+	else
+		processBands<accuracy, ramped, KernelFlags::all>(call);
+}
+
+template <WaveshaperAccuracy accuracy>
+static void processBandsWithRamps(const BandCall& call)
+{
+	if (call.ramps != nullptr)
+		processBandsWithFilter<accuracy, true>(call);
+	else
+		processBandsWithFilter<accuracy, false>(call);
+}
+
+//==============================================================================
+void SIMDKernel::process(float* const* channels, int numChannels, int numSamples, const KernelParameters& params, const KernelRamps* ramps, const Waveshaper& waveshaper, ChannelGroupState& state)
+{
+	const KernelCall call = { channels, numChannels, numSamples, params, ramps, waveshaper, nullptr, nullptr, state };
+	processWithFlags<false>(call);
+}
+
+void SIMDKernel::processOversampled(float* const* channels, int numChannels, int numSamples, const KernelParameters& params, const KernelRamps* ramps, const Waveshaper& waveshaper, Oversampler& oversampler, Oversampler::State& oversamplerState, ChannelGroupState& state)
+{
+	const KernelCall call = { channels, numChannels, numSamples, params, ramps, waveshaper, &oversampler, &oversamplerState, state };
+	processWithFlags<true>(call);
+}
+
+void SIMDKernel::processMultiband(float* const* channels, int numChannels, int numSamples, const KernelParameters& params, const BandParameters& bandParams, const KernelRamps* ramps, const Waveshaper& waveshaper, const Crossover& crossover, Crossover::State& crossoverState, ChannelGroupState* bandState)
+{
+	const BandCall call = { channels, numChannels, numSamples, params, bandParams, ramps, crossover, crossoverState, bandState };
+
+	if (waveshaper.getAccuracy() == WaveshaperAccuracy::exact)
+		processBandsWithRamps<WaveshaperAccuracy::exact>(call);
+	else
+		processBandsWithRamps<WaveshaperAccuracy::approximate>(call);
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+    Channel-parallel version of the DistortionAudioProcessor DSP loop.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SIMD.h"
+#include "Waveshaper.h"
+#include "Oversampler.h"
+#include "Crossover.h"
+#include "StateVariableFilter.h"
+#include "LoudnessDetector.h"
+
+//==============================================================================
+// State of EnvelopeFollower, BiquadLowPassFilter and the gain computer for up
+// to Float4::size channels in structure-of-arrays layout: lane N of every
+// member belongs to channel N.
+struct ChannelGroupState
+{
+	Float4 inputEnvelope = Float4::zero();
+	Float4 inputEnvelope1 = Float4::zero();
+	Float4 outputEnvelope = Float4::zero();
+	Float4 outputEnvelope1 = Float4::zero();
+	Float4 z1 = Float4::zero();
+	Float4 z2 = Float4::zero();
+
+	// Peaks of the current gain interval and the gain ramp towards the last
+	// control point
+	Float4 inputPeak = Float4::zero();
+	Float4 outputPeak = Float4::zero();
+	Float4 gain = Float4::broadcast(1.0f);
+	Float4 gainStep = Float4::zero();
+	int gainPhase = 0;
+
+	// State variable filter and its cutoff offset in octaves, which ramps to
+	// the envelope target of every control point
+	Float4 svfZ1 = Float4::zero();
+	Float4 svfZ2 = Float4::zero();
+	Float4 cutoffOffset = Float4::zero();
+	Float4 cutoffStep = Float4::zero();
+
+	// Shaper history of the antiderivative tier
+	AntiderivativeHistory<Float4> shaperHistory;
+
+	// Windows and K-weighting filters of the RMS detectors. history points to
+	// the input ring followed by the output ring, both windowCapacity entries
+	// long. It is owned by the processor, so reset() keeps it.
+	Float4* history = nullptr;
+	LoudnessWindowState<Float4> inputWindow;
+	LoudnessWindowState<Float4> outputWindow;
+	Float4 inputWeighting[4] = {};
+	Float4 outputWeighting[4] = {};
+
+	void reset()
+	{
+		Float4* const rings = history;
+		*this = ChannelGroupState();
+		history = rings;
+	}
+};
+
+//==============================================================================
+// Per-block constants, shared by all lanes
+struct KernelParameters
+{
+	float dynamics = 0.0f;
+	float wetGain = 1.0f;
+	float dryGain = 0.0f;
+
+	// Output is clipped to <-clipLevel, clipLevel>, raised while the limiter
+	// handles the peaks
+	float clipLevel = 1.0f;
+
+	// Gain compensation runs every gainInterval samples, so the envelope
+	// coefficients are per interval rather than per sample
+	int gainInterval = 16;
+	float attackCoef = 0.0f;
+	float releaseCoef = 0.0f;
+
+	float a0 = 0.0f;
+	float a1 = 0.0f;
+	float a2 = 0.0f;
+	float b1 = 0.0f;
+	float b2 = 0.0f;
+
+	// With a prewarp table the state variable filter replaces the biquad and
+	// runs at the host rate. Its cutoff is cutoffOctave, log2(f / fs), plus
+	// modulationDepth octaves per unit of input envelope; svfK is 1 / Q.
+	const PrewarpTable* prewarp = nullptr;
+	float cutoffOctave = 0.0f;
+	float modulationDepth = 0.0f;
+	float svfK = 1.414f;
+
+	// Level detector of the gain computer. The RMS detectors average the last
+	// windowLength gain intervals out of rings of windowCapacity entries, the
+	// K-weighting filters run at the host rate.
+	DetectorMode detector = DetectorMode::peak;
+	int windowLength = 1;
+	int windowCapacity = 1;
+	KWeighting::Coefficients shelf;
+	KWeighting::Coefficients highPass;
+};
+
+//==============================================================================
+// Per-sample values for parameters that are being smoothed. Each array holds
+// one value per sample of the block passed to the kernel.
+struct KernelRamps
+{
+	const float* dynamics = nullptr;
+	const float* wetGain = nullptr;
+	const float* dryGain = nullptr;
+};
+
+//==============================================================================
+// Per-band values of the multiband kernel, lane N belongs to band N. Bands
+// that are not in use have a wet and dry gain of 0. With ramps the gains come
+// from the global ramps instead, wet * mix and dry * mix + dryOffset.
+struct BandParameters
+{
+	alignas(16) float exponent[Crossover::MAX_BANDS] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	alignas(16) float dynamics[Crossover::MAX_BANDS] = {};
+	alignas(16) float wetGain[Crossover::MAX_BANDS] = {};
+	alignas(16) float dryGain[Crossover::MAX_BANDS] = {};
+	alignas(16) float mix[Crossover::MAX_BANDS] = {};
+	alignas(16) float dryOffset[Crossover::MAX_BANDS] = {};
+};
+
+//==============================================================================
+// Parameter states with their own kernel instantiation. The kernel is picked
+// once per block, so common settings skip the work they do not need.
+namespace KernelFlags
+{
+	// Gain compensation, off while Dynamics is 0
+	static const int dynamics = 1 << 0;
+
+	// Dry signal in the mix, off while Mix is 1
+	static const int mixed = 1 << 1;
+
+	// Exponent of 1, the shaper passes its input through
+	static const int identity = 1 << 2;
+
+	// State variable filter with envelope modulated cutoff. Needs the input
+	// envelope, so it always comes with dynamics.
+	static const int modulated = 1 << 3;
+
+	static const int all = dynamics | mixed;
+	static const int count = 16;
+
+	// Blocks with ramps always run with dynamics and mixed
+	inline int get(const KernelParameters& params, const KernelRamps* ramps, float exponent)
+	{
+		const int shaper = (exponent == 1.0f) ? identity : 0;
+		const int filter = (params.prewarp != nullptr) ? modulated | dynamics : 0;
+
+		if (ramps != nullptr)
+			return all | shaper | filter;
+
+		return (params.dynamics != 0.0f ? dynamics : 0) | (params.dryGain != 0.0f ? mixed : 0) | shaper | filter;
+	}
+}
+
+//==============================================================================
+enum class KernelType
+{
+	scalar,
+	simd
+};
+
+//==============================================================================
+// Processes up to Float4::size channels in the lanes of one Float4, performing the
+// same operations in the same order as the scalar loop. Tools/NullTest checks
+// its output against the scalar path.
+namespace SIMDKernel
+{
+	// True when the CPU supports the instruction set the kernel was built for
+	bool isSupported();
+
+	// With ramps == nullptr the block runs without any per-sample parameter
+	// work, otherwise dynamics, wetGain and dryGain are read from ramps
+	void process(float* const* channels, int numChannels, int numSamples, const KernelParameters& params, const KernelRamps* ramps, const Waveshaper& waveshaper, ChannelGroupState& state);
+
+	// Runs the shaper and low pass filter at the oversampler rate, so the
+	// filter coefficients in params must be calculated for that rate
+	void processOversampled(float* const* channels, int numChannels, int numSamples, const KernelParameters& params, const KernelRamps* ramps, const Waveshaper& waveshaper, Oversampler& oversampler, Oversampler::State& oversamplerState, ChannelGroupState& state);
+
+	// Splits each channel into bands and runs the shaper, filter and gain
+	// compensation of every band in one lane, so a channel with four bands
+	// costs one pass. bandState holds one ChannelGroupState per channel with
+	// lanes as bands, each with its own detector history. The detector and
+	// the modulated filter work as in process(), per band. ramps scale by the
+	// band Mix, band Dynamics replaces the dynamics ramp. Uses the shaper
+	// tier of waveshaper, with the approximation standing in for the table
+	// and antiderivative tiers.
+	void processMultiband(float* const* channels, int numChannels, int numSamples, const KernelParameters& params, const BandParameters& bandParams, const KernelRamps* ramps, const Waveshaper& waveshaper, const Crossover& crossover, Crossover::State& crossoverState, ChannelGroupState* bandState);
+}
@@ -0,0 +1,72 @@
+/*
+  ==============================================================================
+
+    Immutable DSP tables shared by every processor in the process.
+
+  ==============================================================================
+*/
+
+#include "SharedTables.h"
+#include <mutex>
+
+//==============================================================================
+namespace
+{
+	std::mutex registryLock;
+	std::unique_ptr<SharedTables> registryTables;
+	int registryInstances = 0;
+	double registryBuildMilliseconds = 0.0;
+}
+
+//==============================================================================
+void SharedTables::build()
+{
+	m_prewarp.build();
+}
+
+//==============================================================================
+SharedTables::Handle::Handle()
+{
+	const std::lock_guard<std::mutex> lock(registryLock);
+	++registryInstances;
+}
+
+SharedTables::Handle::~Handle()
+{
+	const std::lock_guard<std::mutex> lock(registryLock);
+
+	if (--registryInstances == 0)
+	{
+		registryTables.reset();
+		registryBuildMilliseconds = 0.0;
+	}
+}
+
+const SharedTables& SharedTables::Handle::prepare()
+{
+	const std::lock_guard<std::mutex> lock(registryLock);
+
+	if (registryTables == nullptr)
+	{
+		const double start = juce::Time::getMillisecondCounterHiRes();
+
+		auto tables = std::make_unique<SharedTables>();
+		tables->build();
+		registryTables = std::move(tables);
+
+		registryBuildMilliseconds = juce::Time::getMillisecondCounterHiRes() - start;
+	}
+
+	return *registryTables;
+}
+
+SharedTables::Stats SharedTables::Handle::getStats() const
+{
+	const std::lock_guard<std::mutex> lock(registryLock);
+
+	Stats stats;
+	stats.instances = registryInstances;
+	stats.tableBytes = (registryTables != nullptr) ? registryTables->getBytes() : 0;
+	stats.buildMilliseconds = registryBuildMilliseconds;
+	return stats;
+}
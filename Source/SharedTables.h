@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    Immutable DSP tables shared by every processor in the process.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StateVariableFilter.h"
+
+//==============================================================================
+// Tables that only depend on constants, built once and read by all
+// instances. Each processor holds a Handle; the tables are built by the first
+// prepare() and freed when the last Handle goes away. prepare() takes a lock
+// and may allocate, so call it from prepareToPlay and keep the reference for
+// the audio thread, where the tables are only read.
+class SharedTables
+{
+public:
+	SharedTables() {};
+
+	struct Stats
+	{
+		int instances = 0;
+		size_t tableBytes = 0;
+		double buildMilliseconds = 0.0;
+	};
+
+	const PrewarpTable& getPrewarpTable() const { return m_prewarp; }
+
+	size_t getBytes() const { return sizeof(m_prewarp); }
+
+	//==============================================================================
+	class Handle
+	{
+	public:
+		Handle();
+		~Handle();
+
+		// Builds the tables on first use
+		const SharedTables& prepare();
+
+		Stats getStats() const;
+
+	private:
+		JUCE_DECLARE_NON_COPYABLE(Handle)
+	};
+
+private:
+	void build();
+
+	PrewarpTable m_prewarp;
+};
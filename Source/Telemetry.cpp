@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    Per-block processing cost, recorded on the audio thread without waiting.
+
+  ==============================================================================
+*/
+
+#include "Telemetry.h"
+
+//==============================================================================
+void Telemetry::prepare(double sampleRate)
+{
+	m_sampleRate = sampleRate;
+	m_secondsPerTick = 1.0 / (double)juce::Time::getHighResolutionTicksPerSecond();
+
+	m_referenceTicks = juce::Time::getHighResolutionTicks();
+	m_referenceMilliseconds = juce::Time::currentTimeMillis();
+}
+
+void Telemetry::endBlock(juce::int64 startTicks, int numSamples, bool idle)
+{
+	if (numSamples <= 0)
+		return;
+
+	const float seconds = (float)((double)(juce::Time::getHighResolutionTicks() - startTicks) * m_secondsPerTick);
+	const float load = (float)((double)seconds * m_sampleRate / (double)numSamples);
+
+	// Single writer, so load and store cannot lose a larger value
+	if (seconds > m_worstSeconds.load(std::memory_order_relaxed))
+		m_worstSeconds.store(seconds, std::memory_order_relaxed);
+
+	if (load > m_worstLoad.load(std::memory_order_relaxed))
+		m_worstLoad.store(load, std::memory_order_relaxed);
+
+	const auto scope = m_fifo.write(1);
+
+	if (scope.blockSize1 + scope.blockSize2 == 0)
+	{
+		m_droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	auto& timing = m_fifoData[scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2];
+	timing.startTicks = startTicks;
+	timing.numSamples = numSamples;
+	timing.idle = idle;
+	timing.seconds = seconds;
+	timing.load = load;
+}
+
+//==============================================================================
+void Telemetry::collect()
+{
+	const auto scope = m_fifo.read(m_fifo.getNumReady());
+	const int count = scope.blockSize1 + scope.blockSize2;
+
+	if (count == 0)
+		return;
+
+	float loadSum = 0.0f;
+
+	scope.forEach([this, &loadSum](int index)
+	{
+		const auto& timing = m_fifoData[index];
+
+		m_history[(size_t)m_historyIndex] = timing;
+		m_historyIndex = (m_historyIndex + 1) % HISTORY_SIZE;
+		m_historyCount = juce::jmin(m_historyCount + 1, HISTORY_SIZE);
+
+		const int bin = juce::jlimit(0, HISTOGRAM_BINS - 1, (int)(timing.load * HISTOGRAM_BINS));
+		m_histogram[bin]++;
+
+		loadSum += timing.load;
+		m_idle = timing.idle;
+	});
+
+	m_load = loadSum / (float)count;
+}
+
+void Telemetry::resetStatistics()
+{
+	std::fill(std::begin(m_histogram), std::end(m_histogram), 0);
+	m_historyIndex = 0;
+	m_historyCount = 0;
+	m_load = 0.0f;
+
+	m_worstSeconds.store(0.0f, std::memory_order_relaxed);
+	m_worstLoad.store(0.0f, std::memory_order_relaxed);
+	m_droppedBlocks.store(0, std::memory_order_relaxed);
+}
+
+int Telemetry::getHistogramMaximum() const
+{
+	return *std::max_element(std::begin(m_histogram), std::end(m_histogram));
+}
+
+double Telemetry::ticksToMilliseconds(juce::int64 ticks) const
+{
+	return (double)m_referenceMilliseconds + 1000.0 * (double)(ticks - m_referenceTicks) * m_secondsPerTick;
+}
+
+//==============================================================================
+juce::String Telemetry::exportCsv() const
+{
+	juce::MemoryOutputStream out;
+	out << "time_ms,samples,idle,seconds,load\n";
+
+	const int first = (m_historyIndex - m_historyCount + HISTORY_SIZE) % HISTORY_SIZE;
+
+	for (int i = 0; i < m_historyCount; ++i)
+	{
+		const auto& timing = m_history[(size_t)((first + i) % HISTORY_SIZE)];
+		out << juce::String(ticksToMilliseconds(timing.startTicks), 3) << "," << timing.numSamples << "," << (timing.idle ? 1 : 0) << ","
+		    << juce::String(timing.seconds, 9) << "," << juce::String(timing.load, 6) << "\n";
+	}
+
+	return out.toString();
+}
+
+juce::String Telemetry::exportJson() const
+{
+	juce::Array<juce::var> histogram;
+
+	for (const int count : m_histogram)
+		histogram.add(count);
+
+	juce::Array<juce::var> blocks;
+	const int first = (m_historyIndex - m_historyCount + HISTORY_SIZE) % HISTORY_SIZE;
+
+	for (int i = 0; i < m_historyCount; ++i)
+	{
+		const auto& timing = m_history[(size_t)((first + i) % HISTORY_SIZE)];
+
+		auto* block = new juce::DynamicObject();
+		block->setProperty("timeMs", ticksToMilliseconds(timing.startTicks));
+		block->setProperty("samples", timing.numSamples);
+		block->setProperty("idle", timing.idle);
+		block->setProperty("seconds", timing.seconds);
+		block->setProperty("load", timing.load);
+		blocks.add(juce::var(block));
+	}
+
+	auto* root = new juce::DynamicObject();
+	root->setProperty("sampleRate", m_sampleRate);
+	root->setProperty("worstSeconds", getWorstSeconds());
+	root->setProperty("worstLoad", getWorstLoad());
+	root->setProperty("droppedBlocks", getDroppedBlocks());
+	root->setProperty("histogram", histogram);
+	root->setProperty("blocks", blocks);
+
+	return juce::JSON::toString(juce::var(root));
+}
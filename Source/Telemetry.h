@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    Per-block processing cost, recorded on the audio thread without waiting.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Cost of one processBlock call
+struct BlockTiming
+{
+	juce::int64 startTicks = 0;
+	int numSamples = 0;
+	bool idle = false;
+
+	// Time spent in processBlock, and as a fraction of the block's duration
+	float seconds = 0.0f;
+	float load = 0.0f;
+};
+
+//==============================================================================
+// The audio thread pushes one BlockTiming per block into an AbstractFifo. When
+// the reader falls behind, timings are dropped and counted instead of waiting.
+// The worst block is also tracked on the audio thread, so it survives drops.
+//
+// collect(), the statistics getters and the exports belong to a single reader
+// thread, normally the message thread.
+class Telemetry
+{
+public:
+	Telemetry() {};
+
+	static const int FIFO_SIZE = 1024;
+	static const int HISTORY_SIZE = 16384;
+
+	// Bins of 5 % of the time budget, the last one collects everything above
+	static const int HISTOGRAM_BINS = 20;
+
+	// Call while the audio thread is stopped
+	void prepare(double sampleRate);
+
+	//==============================================================================
+	// Audio thread
+	juce::int64 beginBlock() const { return juce::Time::getHighResolutionTicks(); }
+	void endBlock(juce::int64 startTicks, int numSamples, bool idle);
+
+	//==============================================================================
+	// Reader thread. Moves pending timings into the history and histogram.
+	void collect();
+	void resetStatistics();
+
+	// Mean load of the blocks taken by the last collect()
+	float getLoad() const { return m_load; }
+
+	// Idle state of the last block taken by collect()
+	bool isIdle() const { return m_idle; }
+
+	float getWorstLoad() const { return m_worstLoad.load(std::memory_order_relaxed); }
+	float getWorstSeconds() const { return m_worstSeconds.load(std::memory_order_relaxed); }
+	int getDroppedBlocks() const { return m_droppedBlocks.load(std::memory_order_relaxed); }
+
+	int getHistogramBin(int bin) const { return m_histogram[bin]; }
+	int getHistogramMaximum() const;
+
+	// History of up to HISTORY_SIZE blocks, with wall clock times
+	juce::String exportCsv() const;
+	juce::String exportJson() const;
+
+private:
+	double ticksToMilliseconds(juce::int64 ticks) const;
+
+	double m_sampleRate = 48000.0;
+	double m_secondsPerTick = 0.0;
+
+	// Wall clock time at m_referenceTicks, to convert block start times
+	juce::int64 m_referenceTicks = 0;
+	juce::int64 m_referenceMilliseconds = 0;
+
+	juce::AbstractFifo m_fifo{ FIFO_SIZE };
+	BlockTiming m_fifoData[FIFO_SIZE];
+
+	std::atomic<float> m_worstSeconds{ 0.0f };
+	std::atomic<float> m_worstLoad{ 0.0f };
+	std::atomic<int> m_droppedBlocks{ 0 };
+
+	// Reader side
+	std::vector<BlockTiming> m_history = std::vector<BlockTiming>(HISTORY_SIZE);
+	int m_historyIndex = 0;
+	int m_historyCount = 0;
+	int m_histogram[HISTOGRAM_BINS] = {};
+	float m_load = 0.0f;
+	bool m_idle = false;
+};
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    Power-law waveshaper, sign(x) * |x|^exponent, with selectable accuracy.
+
+  ==============================================================================
+*/
+
+#include "Waveshaper.h"
+
+//==============================================================================
+void Waveshaper::set(WaveshaperAccuracy accuracy, float exponent)
+{
+	m_accuracy = accuracy;
+	m_exponent = exponent;
+	m_integralScale = 1.0f / (exponent + 1.0f);
+
+	if (m_accuracy == WaveshaperAccuracy::table && m_tableExponent != m_exponent)
+		buildTable();
+}
+
+template <typename SampleType>
+SampleType Waveshaper::processMagnitude(SampleType in) const
+{
+	switch (m_accuracy)
+	{
+	case WaveshaperAccuracy::approximate:
+	case WaveshaperAccuracy::antiderivative:
+	{
+		alignas(16) float lanes[Float4::size];
+		powApproximate(Float4::broadcast((float)in), m_exponent).store(lanes);
+		return (SampleType)lanes[0];
+	}
+	case WaveshaperAccuracy::table:
+		return (SampleType)lookup((float)in);
+	default:
+		return std::pow(in, (SampleType)m_exponent);
+	}
+}
+
+template float Waveshaper::processMagnitude<float>(float) const;
+template double Waveshaper::processMagnitude<double>(double) const;
+
+// Same operations as the Float4 version, so the float path matches it
+template <typename SampleType>
+SampleType Waveshaper::processAntiderivative(SampleType in, AntiderivativeHistory<SampleType>& history) const
+{
+	alignas(16) float lanes[Float4::size];
+	const SampleType inAbs = std::abs(in);
+	powApproximate(Float4::broadcast((float)inAbs), m_exponent).store(lanes);
+
+	const SampleType magnitude = (SampleType)lanes[0];
+	const SampleType shaped = (in >= SampleType(0)) ? magnitude : -magnitude;
+	const SampleType integral = inAbs * magnitude * (SampleType)m_integralScale;
+
+	const SampleType delta = in - history.in1;
+	const SampleType threshold = (SampleType)ANTIDERIVATIVE_THRESHOLD * std::max(inAbs, std::abs(history.in1));
+	const SampleType out = (std::abs(delta) > threshold) ? (integral - history.integral1) / delta : SampleType(0.5) * (shaped + history.shaped1);
+
+	history.in1 = in;
+	history.shaped1 = shaped;
+	history.integral1 = integral;
+	return out;
+}
+
+template <typename SampleType>
+void Waveshaper::updateHistory(AntiderivativeHistory<SampleType>& history) const
+{
+	if (history.exponent == m_exponent)
+		return;
+
+	alignas(16) float lanes[Float4::size];
+	const SampleType inAbs = std::abs(history.in1);
+	powApproximate(Float4::broadcast((float)inAbs), m_exponent).store(lanes);
+
+	const SampleType magnitude = (SampleType)lanes[0];
+	history.shaped1 = (history.in1 >= SampleType(0)) ? magnitude : -magnitude;
+	history.integral1 = inAbs * magnitude * (SampleType)m_integralScale;
+	history.exponent = m_exponent;
+}
+
+template float Waveshaper::processAntiderivative<float>(float, AntiderivativeHistory<float>&) const;
+template double Waveshaper::processAntiderivative<double>(double, AntiderivativeHistory<double>&) const;
+template void Waveshaper::updateHistory<float>(AntiderivativeHistory<float>&) const;
+template void Waveshaper::updateHistory<double>(AntiderivativeHistory<double>&) const;
+
+//==============================================================================
+void Waveshaper::buildTable()
+{
+	// Entry i sits at 2^(octave) * (1 + step / TABLE_STEPS_PER_OCTAVE), so the
+	// index can be read straight from the exponent and top mantissa bits
+	for (int i = 0; i < TABLE_SIZE; ++i)
+	{
+		const int octave = TABLE_MIN_OCTAVE + i / TABLE_STEPS_PER_OCTAVE;
+		const int step = i % TABLE_STEPS_PER_OCTAVE;
+		const double x = std::ldexp(1.0 + (double)step / TABLE_STEPS_PER_OCTAVE, octave);
+
+		m_table[i] = (float)std::pow(x, (double)m_exponent);
+	}
+
+	m_tableExponent = m_exponent;
+}
+
+float Waveshaper::lookup(float in) const
+{
+	static const int STEP_BITS = 6;
+	static const int FRACTION_BITS = 23 - STEP_BITS;
+	static const uint32_t FIRST_INDEX = (uint32_t)(127 + TABLE_MIN_OCTAVE) << STEP_BITS;
+	static const float FRACTION_SCALE = 1.0f / (float)(1 << FRACTION_BITS);
+	static_assert((1 << STEP_BITS) == TABLE_STEPS_PER_OCTAVE, "Table index must be taken from the mantissa bits");
+
+	const float tableStart = Float4::fromBits(FIRST_INDEX << FRACTION_BITS);
+
+	if (in < tableStart)
+		return in > 0.0f ? m_table[0] * in / tableStart : 0.0f;
+
+	const uint32_t bits = Float4::toBits(in);
+	const uint32_t index = (bits >> FRACTION_BITS) - FIRST_INDEX;
+
+	if (index >= (uint32_t)(TABLE_SIZE - 1))
+		return m_table[TABLE_SIZE - 1];
+
+	const float fraction = (float)(bits & ((1u << FRACTION_BITS) - 1)) * FRACTION_SCALE;
+	return m_table[index] + fraction * (m_table[index + 1] - m_table[index]);
+}
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    Small thread pool for splitting a block's channel groups across cores.
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+//==============================================================================
+void WorkerPool::prepare(int workers)
+{
+	workers = juce::jlimit(0, MAX_THREADS - 1, workers);
+
+	if (workers == m_workers.size())
+		return;
+
+	for (auto* worker : m_workers)
+	{
+		worker->signalThreadShouldExit();
+		worker->m_start.signal();
+	}
+
+	for (auto* worker : m_workers)
+		worker->stopThread(-1);
+
+	m_workers.clear();
+
+	for (int thread = 1; thread <= workers; ++thread)
+		m_workers.add(new Worker(*this, thread))->startThread();
+}
+
+void WorkerPool::dispatch(int tasks)
+{
+	// Everything the workers read is in place before the counter opens
+	m_tasks.store(tasks);
+	m_pendingTasks.store(tasks);
+	m_nextTask.store(0);
+
+	for (auto* worker : m_workers)
+		worker->m_start.signal();
+
+	work(0);
+	m_done.wait(-1);
+
+	// Workers that wake late find nothing left to take
+	m_nextTask.store(CLOSED);
+}
+
+void WorkerPool::work(int thread)
+{
+	for (;;)
+	{
+		const int task = m_nextTask.fetch_add(1);
+
+		if (task >= m_tasks)
+			return;
+
+		m_invoke(m_context, task, thread);
+
+		if (m_pendingTasks.fetch_sub(1) == 1)
+			m_done.signal();
+	}
+}
+
+//==============================================================================
+void WorkerPool::Worker::run()
+{
+	while (!threadShouldExit())
+	{
+		m_start.wait(-1);
+
+		if (threadShouldExit())
+			break;
+
+		m_pool.work(m_thread);
+	}
+}
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    Small thread pool for splitting a block's channel groups across cores.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Worker threads are started by prepare() and wait on an event between jobs.
+// run() hands out tasks through an atomic counter to the workers and to the
+// calling thread, which takes part, and returns once every task is done.
+// Jobs are a pointer to the caller's function object, so run() does not
+// allocate. One job at a time, always from the same thread.
+class WorkerPool
+{
+public:
+	WorkerPool() {};
+	~WorkerPool() { prepare(0); }
+
+	// Including the calling thread
+	static const int MAX_THREADS = 8;
+
+	// Starts or stops workers to match, call from prepareToPlay
+	void prepare(int workers);
+
+	// Workers plus the calling thread
+	int getNumThreads() const { return m_workers.size() + 1; }
+
+	// Calls function(task, thread) for every task in [0, tasks). thread is 0
+	// on the calling thread and 1 to getNumThreads() - 1 on the workers, so
+	// per-thread scratch can be indexed by it.
+	template <typename Function>
+	void run(int tasks, Function& function)
+	{
+		if (m_workers.size() == 0 || tasks < 2)
+		{
+			for (int task = 0; task < tasks; ++task)
+				function(task, 0);
+
+			return;
+		}
+
+		m_context = &function;
+		m_invoke = [](void* context, int task, int thread) { (*static_cast<Function*>(context))(task, thread); };
+		dispatch(tasks);
+	}
+
+private:
+	class Worker : public juce::Thread
+	{
+	public:
+		Worker(WorkerPool& pool, int thread) : juce::Thread("Distortion worker"), m_pool(pool), m_thread(thread) {}
+
+		void run() override;
+
+		juce::WaitableEvent m_start;
+
+	private:
+		WorkerPool& m_pool;
+		const int m_thread;
+	};
+
+	// Past any task count, the counter rests here between jobs
+	static const int CLOSED = 1 << 30;
+
+	void dispatch(int tasks);
+	void work(int thread);
+
+	juce::OwnedArray<Worker> m_workers;
+
+	void* m_context = nullptr;
+	void (*m_invoke)(void*, int, int) = nullptr;
+	std::atomic<int> m_tasks{ 0 };
+
+	std::atomic<int> m_nextTask{ CLOSED };
+	std::atomic<int> m_pendingTasks{ 0 };
+	juce::WaitableEvent m_done;
+};
@@ -0,0 +1,527 @@
+/*
+  ==============================================================================
+
+    Micro-benchmarks for the DSP stages and the whole processBlock.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include <iostream>
+
+//==============================================================================
+// Every case reports the median of REPETITIONS timed runs, each one long
+// enough to take at least MIN_RUN_SECONDS. Costs are in ns per sample and
+// channel, so results for different channel counts compare directly.
+static const int REPETITIONS = 5;
+static const double MIN_RUN_SECONDS = 0.01;
+
+static const int BLOCK_SIZES[] = { 1, 16, 64, 256, 1024, 4096 };
+static const int CHANNEL_COUNTS[] = { 1, 2, 6, 16 };
+
+// Parameter settings for processBlock, covering the dynamics and mix branches,
+// the shaper and oversampling choices, multiband, the limiter, the detectors,
+// offline rendering, which runs at least 4x on the worker pool, and the host
+// bypass, which only delays the input by the limiter's latency
+struct BenchmarkSetting
+{
+	const char* name;
+	float drive;
+	float dynamics;
+	float mix;
+	int shaper;
+	int oversampling;
+	int bands;
+	int limiter;
+	int offline;
+	int detector;
+	int bypass;
+};
+
+static const BenchmarkSetting SETTINGS[] =
+{
+	{ "default",      0.5f, 0.0f, 1.0f, 0, 0, 1, 0, 0, 0, 0 },
+	{ "dynamics",     0.5f, 1.0f, 1.0f, 0, 0, 1, 0, 0, 0, 0 },
+	{ "mix",          0.5f, 0.0f, 0.5f, 0, 0, 1, 0, 0, 0, 0 },
+	{ "dynamics+mix", 0.5f, 1.0f, 0.5f, 0, 0, 1, 0, 0, 0, 0 },
+	{ "fast",         0.5f, 1.0f, 0.5f, 1, 0, 1, 0, 0, 0, 0 },
+	{ "table",        0.5f, 1.0f, 0.5f, 2, 0, 1, 0, 0, 0, 0 },
+	{ "adaa",         0.5f, 1.0f, 0.5f, 3, 0, 1, 0, 0, 0, 0 },
+	{ "4x",           0.5f, 1.0f, 0.5f, 1, 2, 1, 0, 0, 0, 0 },
+	{ "4band",        0.5f, 1.0f, 0.5f, 0, 0, 4, 0, 0, 0, 0 },
+	{ "4band/fast",   0.5f, 1.0f, 0.5f, 1, 0, 4, 0, 0, 0, 0 },
+	{ "limiter",      0.5f, 1.0f, 0.5f, 0, 0, 1, 1, 0, 0, 0 },
+	{ "rms",          0.5f, 1.0f, 0.5f, 0, 0, 1, 0, 0, 1, 0 },
+	{ "k-weighted",   0.5f, 1.0f, 0.5f, 0, 0, 1, 0, 0, 2, 0 },
+	{ "offline",      0.5f, 1.0f, 0.5f, 0, 0, 1, 0, 1, 0, 0 },
+	{ "bypass",       0.5f, 1.0f, 0.5f, 0, 0, 1, 1, 0, 0, 1 }
+};
+
+// Keeps results alive so the optimiser cannot drop the measured loops
+static volatile float sink = 0.0f;
+
+//==============================================================================
+class Benchmark
+{
+public:
+	Benchmark(const juce::String& filter) : m_filter(filter) {}
+
+	void runStages();
+	void runProcessBlock();
+
+	juce::var getResults() const { return m_results; }
+
+private:
+	bool isSelected(const juce::String& name) const { return m_filter.isEmpty() || name.contains(m_filter); }
+
+	// Calls run(), which processes samplesPerRun samples, until the median
+	// repetition is known
+	template <typename Function>
+	double measure(Function&& run, juce::int64 samplesPerRun);
+
+	// ns per sample and channel for one setting, 0 when the layout is refused
+	template <typename SampleType>
+	double measureProcessBlock(const BenchmarkSetting& setting, int channels, int blockSize);
+
+	void addResult(const juce::String& name, double nsPerSample, int blockSize, int channels);
+	void fillNoise(juce::AudioBuffer<float>& buffer);
+
+	juce::String m_filter;
+	juce::Array<juce::var> m_results;
+	juce::Random m_random{ 1 };
+};
+
+template <typename Function>
+double Benchmark::measure(Function&& run, juce::int64 samplesPerRun)
+{
+	const double ticksPerSecond = (double)juce::Time::getHighResolutionTicksPerSecond();
+
+	// Warm up and find how many calls fill one repetition
+	int calls = 1;
+
+	for (;;)
+	{
+		const auto start = juce::Time::getHighResolutionTicks();
+
+		for (int i = 0; i < calls; ++i)
+			run();
+
+		if ((double)(juce::Time::getHighResolutionTicks() - start) / ticksPerSecond >= MIN_RUN_SECONDS)
+			break;
+
+		calls *= 2;
+	}
+
+	double times[REPETITIONS];
+
+	for (auto& time : times)
+	{
+		const auto start = juce::Time::getHighResolutionTicks();
+
+		for (int i = 0; i < calls; ++i)
+			run();
+
+		time = (double)(juce::Time::getHighResolutionTicks() - start) / ticksPerSecond;
+	}
+
+	std::sort(std::begin(times), std::end(times));
+	return 1.0e9 * times[REPETITIONS / 2] / ((double)calls * (double)samplesPerRun);
+}
+
+void Benchmark::addResult(const juce::String& name, double nsPerSample, int blockSize, int channels)
+{
+	auto* result = new juce::DynamicObject();
+	result->setProperty("name", name);
+	result->setProperty("nsPerSample", nsPerSample);
+	result->setProperty("blockSize", blockSize);
+	result->setProperty("channels", channels);
+	m_results.add(juce::var(result));
+
+	std::cerr << name << ": " << juce::String(nsPerSample, 2) << " ns\n";
+}
+
+void Benchmark::fillNoise(juce::AudioBuffer<float>& buffer)
+{
+	// About -6 dBFS
+	for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+		for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+			buffer.setSample(channel, sample, m_random.nextFloat() - 0.5f);
+}
+
+//==============================================================================
+void Benchmark::runStages()
+{
+	static const int sampleRate = 48000;
+	static const int length = 4096;
+
+	juce::AudioBuffer<float> noise(1, length);
+	fillNoise(noise);
+	const float* in = noise.getReadPointer(0);
+
+	// Same input in double precision
+	std::vector<double> inDouble(in, in + length);
+
+	if (isSelected("stage/envelope"))
+	{
+		EnvelopeFollower<float> envelope;
+		envelope.init(sampleRate);
+		envelope.setCoef(1.0f, 10.0f);
+
+		addResult("stage/envelope", measure([&]
+		{
+			float sum = 0.0f;
+
+			for (int i = 0; i < length; ++i)
+				sum += envelope.process(in[i]);
+
+			sink = sum;
+		}, length), length, 1);
+	}
+
+	if (isSelected("stage/envelope/double"))
+	{
+		EnvelopeFollower<double> envelope;
+		envelope.init(sampleRate);
+		envelope.setCoef(1.0f, 10.0f);
+
+		addResult("stage/envelope/double", measure([&]
+		{
+			double sum = 0.0;
+
+			for (int i = 0; i < length; ++i)
+				sum += envelope.process(inDouble[(size_t)i]);
+
+			sink = (float)sum;
+		}, length), length, 1);
+	}
+
+	if (isSelected("stage/biquad"))
+	{
+		BiquadLowPassFilter<float> filter;
+		filter.init(sampleRate);
+		filter.set(5000.0f, 0.707f);
+
+		addResult("stage/biquad", measure([&]
+		{
+			float sum = 0.0f;
+
+			for (int i = 0; i < length; ++i)
+				sum += filter.process(in[i]);
+
+			sink = sum;
+		}, length), length, 1);
+	}
+
+	if (isSelected("stage/biquad/double"))
+	{
+		BiquadLowPassFilter<double> filter;
+		filter.init(sampleRate);
+		filter.set(5000.0f, 0.707f);
+
+		addResult("stage/biquad/double", measure([&]
+		{
+			double sum = 0.0;
+
+			for (int i = 0; i < length; ++i)
+				sum += filter.process(inDouble[(size_t)i]);
+
+			sink = (float)sum;
+		}, length), length, 1);
+	}
+
+	if (isSelected("stage/biquadSet"))
+	{
+		// Alternate the frequency, set() skips unchanged coefficients
+		BiquadLowPassFilter<float> filter;
+		filter.init(sampleRate);
+
+		addResult("stage/biquadSet", measure([&]
+		{
+			for (int i = 0; i < length; ++i)
+				filter.set((i & 1) ? 5000.0f : 5001.0f, 0.707f);
+
+			sink = filter.getA0();
+		}, length), length, 1);
+	}
+
+	// Waveshaper tiers, scalar and four lanes at once. The antiderivative tier
+	// shapes signed input and carries its history from sample to sample.
+	static const char* tierNames[] = { "exact", "approximate", "table", "antiderivative" };
+
+	for (int tier = 0; tier < 4; ++tier)
+	{
+		const bool antiderivative = (WaveshaperAccuracy)tier == WaveshaperAccuracy::antiderivative;
+		AntiderivativeHistory<float> history;
+		AntiderivativeHistory<double> historyDouble;
+		AntiderivativeHistory<Float4> historyLanes;
+
+		Waveshaper waveshaper;
+		waveshaper.set((WaveshaperAccuracy)tier, 0.505f);
+
+		const juce::String scalarName = juce::String("stage/waveshaper/") + tierNames[tier];
+
+		if (isSelected(scalarName))
+		{
+			addResult(scalarName, measure([&]
+			{
+				float sum = 0.0f;
+
+				for (int i = 0; i < length; ++i)
+					sum += antiderivative ? waveshaper.processAntiderivative(in[i], history) : waveshaper.processMagnitude(std::abs(in[i]));
+
+				sink = sum;
+			}, length), length, 1);
+		}
+
+		const juce::String doubleName = scalarName + "/double";
+
+		if (isSelected(doubleName))
+		{
+			addResult(doubleName, measure([&]
+			{
+				double sum = 0.0;
+
+				for (int i = 0; i < length; ++i)
+					sum += antiderivative ? waveshaper.processAntiderivative(inDouble[(size_t)i], historyDouble) : waveshaper.processMagnitude(std::abs(inDouble[(size_t)i]));
+
+				sink = (float)sum;
+			}, length), length, 1);
+		}
+
+		const juce::String laneName = scalarName + "/lanes";
+
+		if (isSelected(laneName))
+		{
+			addResult(laneName, measure([&]
+			{
+				Float4 sum = Float4::zero();
+
+				for (int i = 0; i + Float4::size <= length; i += Float4::size)
+				{
+					const Float4 signal = Float4::load(in + i);
+					const Float4 magnitude = Float4::abs(signal);
+
+					if (tier == 0)
+						sum = sum + waveshaper.processMagnitude<WaveshaperAccuracy::exact>(magnitude);
+					else if (tier == 1)
+						sum = sum + waveshaper.processMagnitude<WaveshaperAccuracy::approximate>(magnitude);
+					else if (tier == 2)
+						sum = sum + waveshaper.processMagnitude<WaveshaperAccuracy::table>(magnitude);
+					else
+						sum = sum + waveshaper.processAntiderivative(signal, historyLanes);
+				}
+
+				alignas(16) float lanes[Float4::size];
+				sum.store(lanes);
+				sink = lanes[0];
+			}, length), length, 1);
+		}
+	}
+}
+
+//==============================================================================
+static void setParameter(DistortionAudioProcessor& processor, const std::string& name, float value)
+{
+	auto* parameter = processor.apvts.getParameter(name);
+	parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+void Benchmark::runProcessBlock()
+{
+	// Float keeps its names, so older baselines still compare
+	static const char* precisionNames[] = { "processBlock/", "processBlock/double/" };
+
+	for (int precision = 0; precision < 2; ++precision)
+	{
+		for (const auto& setting : SETTINGS)
+		{
+			for (const int channels : CHANNEL_COUNTS)
+			{
+				for (const int blockSize : BLOCK_SIZES)
+				{
+					const juce::String name = precisionNames[precision] + juce::String(setting.name) + "/" + juce::String(channels) + "ch/" + juce::String(blockSize);
+
+					if (!isSelected(name))
+						continue;
+
+					const double nsPerSample = (precision == 0) ? measureProcessBlock<float>(setting, channels, blockSize)
+					                                            : measureProcessBlock<double>(setting, channels, blockSize);
+
+					if (nsPerSample > 0.0)
+						addResult(name, nsPerSample, blockSize, channels);
+				}
+			}
+		}
+	}
+}
+
+template <typename SampleType>
+double Benchmark::measureProcessBlock(const BenchmarkSetting& setting, int channels, int blockSize)
+{
+	static const double sampleRate = 48000.0;
+	static const int minLength = 16384;
+
+	DistortionAudioProcessor processor;
+
+	const auto channelSet = juce::AudioChannelSet::canonicalChannelSet(channels);
+	juce::AudioProcessor::BusesLayout layout;
+	layout.inputBuses.add(channelSet);
+	layout.outputBuses.add(channelSet);
+
+	if (!processor.setBusesLayout(layout))
+		return 0.0;
+
+	setParameter(processor, DistortionAudioProcessor::paramsNames[0], setting.drive);
+	setParameter(processor, DistortionAudioProcessor::paramsNames[1], setting.dynamics);
+	setParameter(processor, DistortionAudioProcessor::paramsNames[2], 5000.0f);
+	setParameter(processor, DistortionAudioProcessor::paramsNames[4], setting.mix);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[0], (float)setting.shaper);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[1], (float)setting.oversampling);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[2], (float)setting.limiter);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[6], (float)setting.detector);
+	setParameter(processor, DistortionAudioProcessor::bypassName, (float)setting.bypass);
+	setParameter(processor, DistortionAudioProcessor::multibandNames[0], (float)(setting.bands - 1));
+
+	for (int band = 0; band < Crossover::MAX_BANDS; ++band)
+	{
+		setParameter(processor, DistortionAudioProcessor::bandParamsNames[band * DistortionAudioProcessor::N_BAND_PARAMS], setting.drive);
+		setParameter(processor, DistortionAudioProcessor::bandParamsNames[band * DistortionAudioProcessor::N_BAND_PARAMS + 1], setting.dynamics);
+	}
+
+	// Parameters are read in prepareToPlay, so nothing is smoothing
+	processor.setNonRealtime(setting.offline != 0);
+	processor.setProcessingPrecision(std::is_same<SampleType, double>::value ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+	processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+	processor.prepareToPlay(sampleRate, blockSize);
+
+	// Each run processes the whole buffer block by block, like a host
+	const int length = juce::jmax(minLength, blockSize);
+	juce::AudioBuffer<float> noise(channels, length);
+	fillNoise(noise);
+
+	juce::AudioBuffer<SampleType> input(channels, length);
+	input.makeCopyOf(noise);
+
+	juce::AudioBuffer<SampleType> buffer(channels, length);
+	juce::AudioBuffer<SampleType> block;
+	juce::MidiBuffer midi;
+	std::vector<SampleType*> pointers((size_t)channels);
+
+	const double nsPerSample = measure([&]
+	{
+		for (int channel = 0; channel < channels; ++channel)
+			buffer.copyFrom(channel, 0, input, channel, 0, length);
+
+		for (int start = 0; start < length; start += blockSize)
+		{
+			for (int channel = 0; channel < channels; ++channel)
+				pointers[(size_t)channel] = buffer.getWritePointer(channel, start);
+
+			block.setDataToReferTo(pointers.data(), channels, blockSize);
+			processor.processBlock(block, midi);
+		}
+	}, (juce::int64)length * channels);
+
+	processor.releaseResources();
+	return nsPerSample;
+}
+
+//==============================================================================
+// Returns the number of results slower than the baseline by more than
+// threshold percent
+static int compareWithBaseline(const juce::var& results, const juce::var& baseline, double threshold)
+{
+	int regressions = 0;
+
+	for (const auto& result : *results.getArray())
+	{
+		for (const auto& reference : *baseline.getArray())
+		{
+			if (reference["name"] != result["name"])
+				continue;
+
+			const double before = reference["nsPerSample"];
+			const double after = result["nsPerSample"];
+			const double change = 100.0 * (after - before) / before;
+
+			if (change > threshold)
+			{
+				std::cerr << "REGRESSION " << result["name"].toString() << ": " << juce::String(before, 2) << " -> " << juce::String(after, 2)
+				          << " ns (+" << juce::String(change, 1) << "%)\n";
+				++regressions;
+			}
+
+			break;
+		}
+	}
+
+	return regressions;
+}
+
+static void printUsage()
+{
+	std::cout << "Usage: DistortionBenchmark [options]\n"
+	             "  --filter <text>        only run cases whose name contains text\n"
+	             "  --output <file>        write JSON results to file instead of stdout\n"
+	             "  --baseline <file>      compare with an earlier JSON result\n"
+	             "  --threshold <percent>  allowed slowdown against the baseline, default 10\n";
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+	juce::ArgumentList args(argc, argv);
+
+	if (args.containsOption("--help|-h"))
+	{
+		printUsage();
+		return 0;
+	}
+
+	const auto filter = args.removeValueForOption("--filter");
+	const auto output = args.removeValueForOption("--output");
+	const auto baselineFile = args.removeValueForOption("--baseline");
+	const double threshold = args.containsOption("--threshold") ? args.removeValueForOption("--threshold").getDoubleValue() : 10.0;
+
+	juce::var baseline;
+
+	if (baselineFile.isNotEmpty())
+	{
+		baseline = juce::JSON::parse(juce::File::getCurrentWorkingDirectory().getChildFile(baselineFile));
+
+		if (!baseline["results"].isArray())
+		{
+			std::cerr << "Invalid baseline " << baselineFile << "\n";
+			return 2;
+		}
+	}
+
+	Benchmark benchmark(filter);
+	benchmark.runStages();
+	benchmark.runProcessBlock();
+
+	auto* report = new juce::DynamicObject();
+	report->setProperty("version", 1);
+	report->setProperty("cpu", juce::SystemStats::getCpuModel());
+	report->setProperty("simd", SIMDKernel::isSupported());
+	report->setProperty("results", benchmark.getResults());
+
+	const juce::var reportVar(report);
+	const auto json = juce::JSON::toString(reportVar);
+
+	if (output.isNotEmpty())
+		juce::File::getCurrentWorkingDirectory().getChildFile(output).replaceWithText(json);
+	else
+		std::cout << json << "\n";
+
+	if (baselineFile.isNotEmpty())
+	{
+		const int regressions = compareWithBaseline(reportVar["results"], baseline["results"], threshold);
+		std::cerr << regressions << " regressions above " << threshold << "%\n";
+		return regressions == 0 ? 0 : 1;
+	}
+
+	return 0;
+}
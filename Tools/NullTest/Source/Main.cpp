@@ -0,0 +1,469 @@
+/*
+  ==============================================================================
+
+    Null tests of the kernel variants against the scalar processBlock.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include <iostream>
+
+//==============================================================================
+// Every test signal is rendered through the scalar kernel in float with the
+// exact shaper, which is the reference, and then through each variant with
+// the same parameters and block size. A variant passes when its largest
+// sample error and its null depth, the RMS of the difference relative to the
+// RMS of the reference, both stay within its budget. The absolute RMS error
+// is reported alongside. Render times are the fastest of REPETITIONS runs and
+// the speedup is reference over variant time.
+//
+// The state check restores the state of a processor with random parameter
+// values into a fresh one, every parameter but the bypass has to come back.
+static const double SAMPLE_RATE = 48000.0;
+static const int CHANNELS = 2;
+static const int LENGTH = 96000;
+static const int BLOCK_SIZE = 512;
+static const int REPETITIONS = 5;
+
+// Null depth of a variant without any difference
+static const double NULL_FLOOR_DB = -200.0;
+
+// Normalised difference allowed for a restored parameter
+static const float STATE_TOLERANCE = 1.0e-6f;
+
+static const char* SIGNAL_NAMES[] = { "sine100", "sine5k", "sweep", "noise", "transients", "silence" };
+
+// Parameter settings for the nulls. Oversampling and multiband only exist in
+// the SIMD kernel, so they have no scalar reference and are not listed.
+struct NullTestSetting
+{
+	const char* name;
+	float drive;
+	float dynamics;
+	float mix;
+	int filter;
+	float cutoffMod;
+	int limiter;
+	int detector;
+};
+
+static const NullTestSetting SETTINGS[] =
+{
+	{ "default",      0.5f, 0.0f, 1.0f, 0, 0.0f, 0, 0 },
+	{ "dynamics+mix", 0.5f, 1.0f, 0.5f, 0, 0.0f, 0, 0 },
+	{ "svf",          0.5f, 1.0f, 0.5f, 1, 2.0f, 0, 0 },
+	{ "limiter",      0.8f, 1.0f, 1.0f, 0, 0.0f, 1, 0 },
+	{ "rms",          0.5f, 1.0f, 0.5f, 0, 0.0f, 0, 1 },
+	{ "k-weighted",   0.5f, 1.0f, 0.5f, 1, 2.0f, 0, 2 }
+};
+
+// A kernel variant and its accuracy budget. The shaper budgets follow the
+// errors listed in Waveshaper.h with a margin for the filter and dynamics.
+struct KernelVariant
+{
+	const char* name;
+	KernelType kernel;
+	int shaper;
+	bool doublePrecision;
+	double maxError;
+	double maxNullDepth;
+};
+
+static const KernelVariant REFERENCE = { "reference", KernelType::scalar, 0, false, 1.0e-5, -110.0 };
+
+static const KernelVariant VARIANTS[] =
+{
+	{ "simd",             KernelType::simd,   0, false, 1.0e-5, -110.0 },
+	{ "approximate",      KernelType::scalar, 1, false, 1.0e-5, -110.0 },
+	{ "table",            KernelType::scalar, 2, false, 1.0e-4,  -90.0 },
+	{ "simd/approximate", KernelType::simd,   1, false, 1.0e-5, -110.0 },
+	{ "simd/table",       KernelType::simd,   2, false, 1.0e-4,  -90.0 },
+	{ "double",           KernelType::scalar, 0, true,  1.0e-4, -100.0 }
+};
+
+//==============================================================================
+// Stereo, the right channel a quarter period ahead or with its own noise
+static void fillSignal(int signal, juce::AudioBuffer<float>& buffer)
+{
+	const double pi = juce::MathConstants<double>::pi;
+	const int burstPeriod = (int)(0.25 * SAMPLE_RATE);
+	const int burstLength = (int)(0.01 * SAMPLE_RATE);
+	const double sweepRate = std::log(1000.0) * SAMPLE_RATE / buffer.getNumSamples();
+
+	juce::Random random(1);
+
+	for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+	{
+		float* out = buffer.getWritePointer(channel);
+		const double phase = 0.5 * pi * channel;
+
+		for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+		{
+			const double time = sample / SAMPLE_RATE;
+			const int burstPosition = sample % burstPeriod;
+
+			switch (signal)
+			{
+			case 0: out[sample] = 0.5f * (float)std::sin(2.0 * pi * 100.0 * time + phase); break;
+			case 1: out[sample] = 0.5f * (float)std::sin(2.0 * pi * 5000.0 * time + phase); break;
+
+			// Exponential, 20 Hz to 20 kHz
+			case 2: out[sample] = 0.5f * (float)std::sin(2.0 * pi * 20.0 * (std::exp(sweepRate * time) - 1.0) / sweepRate + phase); break;
+
+			// About -6 dBFS
+			case 3: out[sample] = random.nextFloat() - 0.5f; break;
+
+			// Noise bursts decaying from 0 dBFS every 250 ms
+			case 4: out[sample] = (burstPosition < burstLength) ? (2.0f * random.nextFloat() - 1.0f) * (float)std::exp(-burstPosition / (0.002 * SAMPLE_RATE)) : 0.0f; break;
+
+			default: out[sample] = 0.0f; break;
+			}
+		}
+	}
+}
+
+static void setParameter(DistortionAudioProcessor& processor, const std::string& name, float value)
+{
+	auto* parameter = processor.apvts.getParameter(name);
+	parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+//==============================================================================
+// Renders input into output block by block like a host, from a freshly
+// prepared processor each run. Returns the fastest run in seconds.
+template <typename SampleType>
+static double render(const NullTestSetting& setting, const KernelVariant& variant, const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output)
+{
+	DistortionAudioProcessor processor;
+
+	juce::AudioProcessor::BusesLayout layout;
+	layout.inputBuses.add(juce::AudioChannelSet::stereo());
+	layout.outputBuses.add(juce::AudioChannelSet::stereo());
+	processor.setBusesLayout(layout);
+
+	setParameter(processor, DistortionAudioProcessor::paramsNames[0], setting.drive);
+	setParameter(processor, DistortionAudioProcessor::paramsNames[1], setting.dynamics);
+	setParameter(processor, DistortionAudioProcessor::paramsNames[2], 5000.0f);
+	setParameter(processor, DistortionAudioProcessor::paramsNames[4], setting.mix);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[0], (float)variant.shaper);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[2], (float)setting.limiter);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[4], (float)setting.filter);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[5], setting.cutoffMod);
+	setParameter(processor, DistortionAudioProcessor::settingsNames[6], (float)setting.detector);
+
+	processor.setPreferredKernel(variant.kernel);
+	processor.setProcessingPrecision(std::is_same<SampleType, double>::value ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+	processor.setRateAndBufferSizeDetails(SAMPLE_RATE, BLOCK_SIZE);
+
+	juce::AudioBuffer<SampleType> buffer(CHANNELS, LENGTH);
+	juce::AudioBuffer<SampleType> block;
+	juce::MidiBuffer midi;
+	SampleType* pointers[CHANNELS] = {};
+
+	const double ticksPerSecond = (double)juce::Time::getHighResolutionTicksPerSecond();
+	double fastest = 0.0;
+
+	for (int run = 0; run < REPETITIONS; ++run)
+	{
+		// Parameters are read in prepareToPlay, so nothing is smoothing
+		processor.prepareToPlay(SAMPLE_RATE, BLOCK_SIZE);
+		buffer.makeCopyOf(input);
+
+		const auto start = juce::Time::getHighResolutionTicks();
+
+		for (int position = 0; position < LENGTH; position += BLOCK_SIZE)
+		{
+			const int count = juce::jmin(BLOCK_SIZE, LENGTH - position);
+
+			for (int channel = 0; channel < CHANNELS; ++channel)
+				pointers[channel] = buffer.getWritePointer(channel, position);
+
+			block.setDataToReferTo(pointers, CHANNELS, count);
+			processor.processBlock(block, midi);
+		}
+
+		const double seconds = (double)(juce::Time::getHighResolutionTicks() - start) / ticksPerSecond;
+		fastest = (run == 0) ? seconds : juce::jmin(fastest, seconds);
+	}
+
+	processor.releaseResources();
+	output.makeCopyOf(buffer);
+	return fastest;
+}
+
+static double render(const NullTestSetting& setting, const KernelVariant& variant, const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output)
+{
+	return variant.doublePrecision ? render<double>(setting, variant, input, output) : render<float>(setting, variant, input, output);
+}
+
+//==============================================================================
+struct NullResult
+{
+	double maxError = 0.0;
+	double rmsError = 0.0;
+	double nullDepth = NULL_FLOOR_DB;
+};
+
+static NullResult compare(const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& output)
+{
+	NullResult result;
+	double referenceSquares = 0.0;
+	double errorSquares = 0.0;
+
+	for (int channel = 0; channel < reference.getNumChannels(); ++channel)
+	{
+		const float* expected = reference.getReadPointer(channel);
+		const float* actual = output.getReadPointer(channel);
+
+		for (int sample = 0; sample < reference.getNumSamples(); ++sample)
+		{
+			const double error = (double)actual[sample] - (double)expected[sample];
+			result.maxError = juce::jmax(result.maxError, std::abs(error));
+			errorSquares += error * error;
+			referenceSquares += (double)expected[sample] * (double)expected[sample];
+		}
+	}
+
+	result.rmsError = std::sqrt(errorSquares / juce::jmax(1, reference.getNumChannels() * reference.getNumSamples()));
+
+	// A difference against silence does not null at all
+	if (errorSquares > 0.0)
+		result.nullDepth = (referenceSquares > 0.0) ? juce::jmax(NULL_FLOOR_DB, 10.0 * std::log10(errorSquares / referenceSquares)) : 0.0;
+
+	return result;
+}
+
+//==============================================================================
+class NullTest
+{
+public:
+	NullTest(const juce::String& filter, const juce::File& goldenDirectory) : m_filter(filter), m_goldenDirectory(goldenDirectory) {}
+
+	void run();
+
+	int getFailures() const { return m_failures; }
+	juce::var getResults() const { return m_results; }
+
+private:
+	bool isSelected(const juce::String& name) const { return m_filter.isEmpty() || name.contains(m_filter); }
+
+	// Checks the reference against the stored golden file, or stores it when
+	// there is none yet
+	void checkGolden(const juce::String& name, const juce::AudioBuffer<float>& reference);
+
+	void checkState();
+
+	void addResult(const juce::String& name, const KernelVariant& variant, const NullResult& result, double speedup);
+
+	juce::String m_filter;
+	juce::File m_goldenDirectory;
+	juce::Array<juce::var> m_results;
+	int m_failures = 0;
+};
+
+void NullTest::run()
+{
+	juce::AudioBuffer<float> input(CHANNELS, LENGTH);
+	juce::AudioBuffer<float> reference;
+	juce::AudioBuffer<float> output;
+
+	if (isSelected("state"))
+		checkState();
+
+	for (const auto& setting : SETTINGS)
+	{
+		for (int signal = 0; signal < juce::numElementsInArray(SIGNAL_NAMES); ++signal)
+		{
+			const juce::String prefix = juce::String(setting.name) + "/" + SIGNAL_NAMES[signal] + "/";
+
+			bool selected = isSelected(prefix + REFERENCE.name);
+
+			for (const auto& variant : VARIANTS)
+				selected = selected || isSelected(prefix + variant.name);
+
+			if (!selected)
+				continue;
+
+			fillSignal(signal, input);
+			const double referenceSeconds = render(setting, REFERENCE, input, reference);
+
+			if (m_goldenDirectory != juce::File())
+				checkGolden(juce::String(setting.name).replace("+", "-") + "-" + SIGNAL_NAMES[signal], reference);
+
+			for (const auto& variant : VARIANTS)
+			{
+				if (!isSelected(prefix + variant.name))
+					continue;
+
+				const double seconds = render(setting, variant, input, output);
+				addResult(prefix + variant.name, variant, compare(reference, output), referenceSeconds / juce::jmax(seconds, 1.0e-9));
+			}
+		}
+	}
+}
+
+void NullTest::checkGolden(const juce::String& name, const juce::AudioBuffer<float>& reference)
+{
+	const juce::File file = m_goldenDirectory.getChildFile(name + ".wav");
+	juce::WavAudioFormat format;
+
+	if (!file.existsAsFile())
+	{
+		// 32 bit WAV holds the floats unchanged
+		std::unique_ptr<juce::FileOutputStream> stream(file.createOutputStream());
+		std::unique_ptr<juce::AudioFormatWriter> writer;
+
+		if (stream != nullptr)
+			writer.reset(format.createWriterFor(stream.get(), SAMPLE_RATE, (unsigned int)CHANNELS, 32, {}, 0));
+
+		if (writer == nullptr)
+		{
+			std::cerr << "Cannot write " << file.getFullPathName() << "\n";
+			++m_failures;
+			return;
+		}
+
+		stream.release();
+		writer->writeFromAudioSampleBuffer(reference, 0, LENGTH);
+		std::cerr << "stored " << file.getFullPathName() << "\n";
+		return;
+	}
+
+	std::unique_ptr<juce::AudioFormatReader> reader(format.createReaderFor(file.createInputStream().release(), true));
+
+	if (reader == nullptr || (int)reader->numChannels != CHANNELS || reader->lengthInSamples != LENGTH)
+	{
+		std::cerr << "Invalid golden file " << file.getFullPathName() << "\n";
+		++m_failures;
+		return;
+	}
+
+	juce::AudioBuffer<float> golden(CHANNELS, LENGTH);
+	reader->read(&golden, 0, LENGTH, 0, true, true);
+
+	addResult("golden/" + name, REFERENCE, compare(golden, reference), 1.0);
+}
+
+void NullTest::checkState()
+{
+	DistortionAudioProcessor source;
+	juce::Random random(1);
+
+	for (auto* parameter : source.getParameters())
+		if (parameter != source.getBypassParameter())
+			parameter->setValueNotifyingHost(random.nextFloat());
+
+	juce::MemoryBlock state;
+	source.getStateInformation(state);
+
+	DistortionAudioProcessor restored;
+	restored.setStateInformation(state.getData(), (int)state.getSize());
+
+	const auto& parameters = source.getParameters();
+	const auto& restoredParameters = restored.getParameters();
+	juce::Array<juce::var> mismatches;
+
+	for (int i = 0; i < parameters.size(); ++i)
+	{
+		if (parameters[i] == source.getBypassParameter())
+			continue;
+
+		if (std::abs(restoredParameters[i]->getValue() - parameters[i]->getValue()) > STATE_TOLERANCE)
+		{
+			mismatches.add(parameters[i]->getName(64));
+			std::cerr << "  " << parameters[i]->getName(64) << " not restored\n";
+		}
+	}
+
+	const bool passed = mismatches.isEmpty();
+
+	if (!passed)
+		++m_failures;
+
+	auto* entry = new juce::DynamicObject();
+	entry->setProperty("name", "state");
+	entry->setProperty("parameters", parameters.size());
+	entry->setProperty("mismatches", mismatches);
+	entry->setProperty("passed", passed);
+	m_results.add(juce::var(entry));
+
+	std::cerr << (passed ? "pass " : "FAIL ") << "state: " << mismatches.size() << " of " << parameters.size() << " parameters not restored\n";
+}
+
+void NullTest::addResult(const juce::String& name, const KernelVariant& variant, const NullResult& result, double speedup)
+{
+	const bool passed = result.maxError <= variant.maxError && result.nullDepth <= variant.maxNullDepth;
+
+	if (!passed)
+		++m_failures;
+
+	auto* entry = new juce::DynamicObject();
+	entry->setProperty("name", name);
+	entry->setProperty("maxError", result.maxError);
+	entry->setProperty("rmsError", result.rmsError);
+	entry->setProperty("nullDepth", result.nullDepth);
+	entry->setProperty("speedup", speedup);
+	entry->setProperty("maxErrorBudget", variant.maxError);
+	entry->setProperty("nullDepthBudget", variant.maxNullDepth);
+	entry->setProperty("passed", passed);
+	m_results.add(juce::var(entry));
+
+	std::cerr << (passed ? "pass " : "FAIL ") << name << ": max " << juce::String(result.maxError, 9) << ", rms " << juce::String(result.rmsError, 9) << ", null " << juce::String(result.nullDepth, 1)
+	          << " dB, " << juce::String(speedup, 2) << "x\n";
+}
+
+//==============================================================================
+static void printUsage()
+{
+	std::cout << "Usage: DistortionNullTest [options]\n"
+	             "  --filter <text>        only run cases whose name contains text\n"
+	             "  --output <file>        write JSON results to file instead of stdout\n"
+	             "  --golden <directory>   compare references with the files stored there,\n"
+	             "                         storing the ones that are missing\n";
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+	juce::ArgumentList args(argc, argv);
+
+	if (args.containsOption("--help|-h"))
+	{
+		printUsage();
+		return 0;
+	}
+
+	const auto filter = args.removeValueForOption("--filter");
+	const auto output = args.removeValueForOption("--output");
+	const auto golden = args.removeValueForOption("--golden");
+
+	juce::File goldenDirectory;
+
+	if (golden.isNotEmpty())
+	{
+		goldenDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(golden);
+		goldenDirectory.createDirectory();
+	}
+
+	NullTest nullTest(filter, goldenDirectory);
+	nullTest.run();
+
+	auto* report = new juce::DynamicObject();
+	report->setProperty("version", 1);
+	report->setProperty("cpu", juce::SystemStats::getCpuModel());
+	report->setProperty("simd", SIMDKernel::isSupported());
+	report->setProperty("results", nullTest.getResults());
+
+	const auto json = juce::JSON::toString(juce::var(report));
+
+	if (output.isNotEmpty())
+		juce::File::getCurrentWorkingDirectory().getChildFile(output).replaceWithText(json);
+	else
+		std::cout << json << "\n";
+
+	std::cerr << nullTest.getFailures() << " failures\n";
+	return nullTest.getFailures() == 0 ? 0 : 1;
+}
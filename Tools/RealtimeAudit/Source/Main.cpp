@@ -0,0 +1,383 @@
+/*
+  ==============================================================================
+
+    Realtime-safety audit of processBlock, built with ZAZZ_REALTIME_AUDIT=1.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include <iostream>
+
+//==============================================================================
+// One processor is taken through every scenario like a host would: the layout,
+// precision, kernel, rate and block size change between them with a release
+// and prepare. Each scenario runs BLOCKS callbacks of random length up to its
+// host block size, with noise or silence, some preceded by automation applied
+// the way the wrapper does on the audio thread. Host blocks longer than the
+// prepared size take the processor's split path. Between callbacks, as the
+// message thread, it randomises all parameters, switches presets, restores
+// state and re-prepares at another rate. Anything the audit records inside
+// processBlock is a failure.
+//
+// Limiter scenarios instead keep the limiter on at its longest lookahead and
+// re-prepare at every event, alternating with a lower rate. The lookahead in
+// samples then shrinks under a running limiter, which a debug build checks.
+static const int BLOCKS = 2000;
+
+// Callbacks between message thread events, and the chance of in-callback
+// automation and of a silent block
+static const int EVENT_INTERVAL = 25;
+static const float AUTOMATION_CHANCE = 0.25f;
+static const float SILENCE_CHANCE = 0.2f;
+
+// Distinct stacks reported per scenario
+static const int MAX_REPORTED = 16;
+
+// Enough for third order ambisonics and more
+static const int MAX_CHANNELS = 64;
+
+struct AuditScenario
+{
+	const char* name;
+	KernelType kernel;
+	bool doublePrecision;
+	int channels;
+	double sampleRate;
+	int blockSize;
+
+	// Longest block the host passes, and the rate limiter scenarios alternate
+	// with, 0 for the randomised events
+	int hostBlockSize;
+	double limiterRate;
+};
+
+static const AuditScenario SCENARIOS[] =
+{
+	{ "simd/stereo/48k/512",          KernelType::simd,   false, 2,  48000.0,  512,  512,  0.0 },
+	{ "simd/mono/44k/64",             KernelType::simd,   false, 1,  44100.0,  64,   64,   0.0 },
+	{ "simd/6ch/96k/1024",            KernelType::simd,   false, 6,  96000.0,  1024, 1024, 0.0 },
+	{ "simd/stereo/192k/32",          KernelType::simd,   false, 2,  192000.0, 32,   32,   0.0 },
+	{ "simd/36ch/48k/256",            KernelType::simd,   false, 36, 48000.0,  256,  256,  0.0 },
+	{ "simd/stereo/48k/128-split",    KernelType::simd,   false, 2,  48000.0,  128,  1000, 0.0 },
+	{ "simd/36ch/48k/64-split",       KernelType::simd,   false, 36, 48000.0,  64,   300,  0.0 },
+	{ "scalar/stereo/48k/256",        KernelType::scalar, false, 2,  48000.0,  256,  256,  0.0 },
+	{ "scalar/6ch/44k/128",           KernelType::scalar, false, 6,  44100.0,  128,  128,  0.0 },
+	{ "scalar/36ch/48k/128-split",    KernelType::scalar, false, 36, 48000.0,  128,  512,  0.0 },
+	{ "double/stereo/48k/512",        KernelType::scalar, true,  2,  48000.0,  512,  512,  0.0 },
+	{ "double/mono/88k/128",          KernelType::scalar, true,  1,  88200.0,  128,  128,  0.0 },
+	{ "double/stereo/48k/64-split",   KernelType::scalar, true,  2,  48000.0,  64,   700,  0.0 },
+	{ "limiter/stereo/96k-44k/256",   KernelType::simd,   false, 2,  96000.0,  256,  256,  44100.0 },
+	{ "limiter/double/96k-44k/256",   KernelType::scalar, true,  2,  96000.0,  256,  256,  44100.0 }
+};
+
+//==============================================================================
+// Stands in for the plugin wrapper. Host notifications from the audio thread
+// lock and call into the host, so they are recorded as well.
+class HostListener : public juce::AudioProcessorListener
+{
+public:
+	void audioProcessorParameterChanged(juce::AudioProcessor*, int, float) override
+	{
+		RealtimeAudit::checkBoundary("audioProcessorParameterChanged");
+	}
+
+	void audioProcessorChanged(juce::AudioProcessor*, const ChangeDetails&) override
+	{
+		RealtimeAudit::checkBoundary("audioProcessorChanged");
+	}
+};
+
+//==============================================================================
+class Audit
+{
+public:
+	Audit(const juce::String& filter, int seed) : m_filter(filter), m_random(seed) {}
+
+	void run();
+
+	int getFailures() const { return m_failures; }
+	juce::var getResults() const { return m_results; }
+
+private:
+	template <typename SampleType>
+	void runScenario(DistortionAudioProcessor& processor, const AuditScenario& scenario);
+
+	void prepare(DistortionAudioProcessor& processor, const AuditScenario& scenario, double sampleRate);
+	void randomiseParameters();
+
+	// Limiter on at its longest lookahead, bypass off
+	void setLimiterOn(DistortionAudioProcessor& processor);
+	void messageThreadEvent(DistortionAudioProcessor& processor, const AuditScenario& scenario);
+
+	// Host automation as the plugin wrapper applies it on the audio thread.
+	// The wrapper's listener lock is outside processBlock and not audited.
+	void automate();
+
+	void addResult(const AuditScenario& scenario);
+
+	juce::String m_filter;
+	juce::Random m_random;
+	juce::Array<juce::AudioProcessorParameter*> m_parameters;
+	juce::MemoryBlock m_savedState;
+	juce::Array<juce::var> m_results;
+	int m_failures = 0;
+};
+
+void Audit::run()
+{
+	DistortionAudioProcessor processor;
+	HostListener listener;
+	processor.addListener(&listener);
+
+	m_parameters = processor.getParameters();
+	processor.getStateInformation(m_savedState);
+
+	for (const auto& scenario : SCENARIOS)
+	{
+		if (m_filter.isNotEmpty() && !juce::String(scenario.name).contains(m_filter))
+			continue;
+
+		RealtimeAudit::clear();
+
+		if (scenario.doublePrecision)
+			runScenario<double>(processor, scenario);
+		else
+			runScenario<float>(processor, scenario);
+
+		addResult(scenario);
+	}
+
+	processor.releaseResources();
+	processor.removeListener(&listener);
+}
+
+template <typename SampleType>
+void Audit::runScenario(DistortionAudioProcessor& processor, const AuditScenario& scenario)
+{
+	processor.releaseResources();
+
+	juce::AudioProcessor::BusesLayout layout;
+	layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(scenario.channels));
+	layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(scenario.channels));
+	processor.setBusesLayout(layout);
+
+	processor.setPreferredKernel(scenario.kernel);
+	processor.setProcessingPrecision(scenario.doublePrecision ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+
+	if (scenario.limiterRate > 0.0)
+		setLimiterOn(processor);
+
+	prepare(processor, scenario, scenario.sampleRate);
+
+	jassert(scenario.channels <= MAX_CHANNELS);
+	juce::AudioBuffer<SampleType> buffer(scenario.channels, scenario.hostBlockSize);
+	juce::AudioBuffer<SampleType> block;
+	juce::MidiBuffer midi;
+	SampleType* pointers[MAX_CHANNELS] = {};
+	bool lowerRate = false;
+
+	for (int index = 0; index < BLOCKS; ++index)
+	{
+		if (index > 0 && index % EVENT_INTERVAL == 0)
+		{
+			if (scenario.limiterRate > 0.0)
+			{
+				lowerRate = !lowerRate;
+				processor.releaseResources();
+				prepare(processor, scenario, lowerRate ? scenario.limiterRate : scenario.sampleRate);
+			}
+			else
+			{
+				messageThreadEvent(processor, scenario);
+			}
+		}
+
+		// Hosts pass shorter blocks, and occasionally empty ones
+		const int samples = (m_random.nextInt(4) == 0) ? scenario.hostBlockSize : m_random.nextInt(scenario.hostBlockSize + 1);
+		const bool silent = m_random.nextFloat() < SILENCE_CHANCE;
+
+		for (int channel = 0; channel < scenario.channels; ++channel)
+		{
+			SampleType* data = buffer.getWritePointer(channel);
+
+			for (int sample = 0; sample < samples; ++sample)
+				data[sample] = silent ? SampleType() : (SampleType)(m_random.nextFloat() - 0.5f);
+
+			pointers[channel] = data;
+		}
+
+		block.setDataToReferTo(pointers, scenario.channels, samples);
+
+		if (scenario.limiterRate == 0.0 && m_random.nextFloat() < AUTOMATION_CHANCE)
+			automate();
+
+		processor.processBlock(block, midi);
+	}
+}
+
+void Audit::prepare(DistortionAudioProcessor& processor, const AuditScenario& scenario, double sampleRate)
+{
+	processor.setRateAndBufferSizeDetails(sampleRate, scenario.blockSize);
+	processor.prepareToPlay(sampleRate, scenario.blockSize);
+}
+
+void Audit::randomiseParameters()
+{
+	for (auto* parameter : m_parameters)
+		parameter->setValueNotifyingHost(m_random.nextFloat());
+}
+
+void Audit::setLimiterOn(DistortionAudioProcessor& processor)
+{
+	processor.apvts.getParameter(DistortionAudioProcessor::settingsNames[2])->setValueNotifyingHost(1.0f);
+	processor.apvts.getParameter(DistortionAudioProcessor::settingsNames[3])->setValueNotifyingHost(1.0f);
+	processor.apvts.getParameter(DistortionAudioProcessor::bypassName)->setValueNotifyingHost(0.0f);
+}
+
+void Audit::automate()
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		auto* parameter = m_parameters[m_random.nextInt(m_parameters.size())];
+		const float value = m_random.nextFloat();
+		parameter->setValue(value);
+		parameter->sendValueChangedMessageToListeners(value);
+	}
+}
+
+void Audit::messageThreadEvent(DistortionAudioProcessor& processor, const AuditScenario& scenario)
+{
+	switch (m_random.nextInt(5))
+	{
+	case 0:
+		randomiseParameters();
+		break;
+
+	case 1:
+		processor.setCurrentProgram(m_random.nextInt(processor.getNumPrograms()));
+		break;
+
+	case 2:
+		processor.setStateInformation(m_savedState.getData(), (int)m_savedState.getSize());
+		break;
+
+	case 3:
+	{
+		juce::MemoryBlock state;
+		processor.getStateInformation(state);
+		processor.setStateInformation(state.getData(), (int)state.getSize());
+		break;
+	}
+
+	default:
+	{
+		// Same layout, another rate
+		static const double rates[] = { 44100.0, 48000.0, 96000.0 };
+		processor.releaseResources();
+		prepare(processor, scenario, rates[m_random.nextInt(juce::numElementsInArray(rates))]);
+		break;
+	}
+	}
+}
+
+void Audit::addResult(const AuditScenario& scenario)
+{
+	// Identical stacks are reported once with their count
+	const int count = RealtimeAudit::getNumViolations();
+	juce::StringArray descriptions;
+	juce::Array<int> counts;
+
+	for (int index = 0; index < juce::jmin(count, RealtimeAudit::MAX_VIOLATIONS); ++index)
+	{
+		const auto description = RealtimeAudit::describe(RealtimeAudit::getViolation(index));
+		const int existing = descriptions.indexOf(description);
+
+		if (existing >= 0)
+			counts.getReference(existing) += 1;
+		else if (descriptions.size() < MAX_REPORTED)
+		{
+			descriptions.add(description);
+			counts.add(1);
+		}
+	}
+
+	juce::Array<juce::var> violations;
+
+	for (int i = 0; i < descriptions.size(); ++i)
+	{
+		auto* entry = new juce::DynamicObject();
+		entry->setProperty("count", counts[i]);
+		entry->setProperty("stack", descriptions[i]);
+		violations.add(juce::var(entry));
+
+		std::cerr << "  " << counts[i] << "x " << descriptions[i] << "\n";
+	}
+
+	const bool passed = count == 0;
+
+	if (!passed)
+		++m_failures;
+
+	auto* result = new juce::DynamicObject();
+	result->setProperty("name", scenario.name);
+	result->setProperty("blocks", BLOCKS);
+	result->setProperty("violations", count);
+	result->setProperty("stacks", violations);
+	result->setProperty("passed", passed);
+	m_results.add(juce::var(result));
+
+	std::cerr << (passed ? "pass " : "FAIL ") << scenario.name << ": " << count << " violations\n";
+}
+
+//==============================================================================
+static void printUsage()
+{
+	std::cout << "Usage: DistortionRealtimeAudit [options]\n"
+	             "  --filter <text>   only run scenarios whose name contains text\n"
+	             "  --seed <n>        seed for block sizes, signals and automation\n"
+	             "  --output <file>   write JSON results to file instead of stdout\n";
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+	juce::ArgumentList args(argc, argv);
+
+	if (args.containsOption("--help|-h"))
+	{
+		printUsage();
+		return 0;
+	}
+
+	if (!RealtimeAudit::isEnabled())
+	{
+		std::cerr << "Built without ZAZZ_REALTIME_AUDIT, nothing would be recorded\n";
+		return 1;
+	}
+
+	const auto filter = args.removeValueForOption("--filter");
+	const auto seed = args.removeValueForOption("--seed");
+	const auto output = args.removeValueForOption("--output");
+
+	Audit audit(filter, seed.isNotEmpty() ? seed.getIntValue() : 1);
+	audit.run();
+
+	auto* report = new juce::DynamicObject();
+	report->setProperty("version", 1);
+	report->setProperty("cpu", juce::SystemStats::getCpuModel());
+	report->setProperty("simd", SIMDKernel::isSupported());
+	report->setProperty("results", audit.getResults());
+
+	const auto json = juce::JSON::toString(juce::var(report));
+
+	if (output.isNotEmpty())
+		juce::File::getCurrentWorkingDirectory().getChildFile(output).replaceWithText(json);
+	else
+		std::cout << json << "\n";
+
+	std::cerr << audit.getFailures() << " failures\n";
+	return audit.getFailures() == 0 ? 0 : 1;
+}
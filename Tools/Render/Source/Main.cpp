@@ -0,0 +1,336 @@
+/*
+  ==============================================================================
+
+    Offline batch renderer, streams audio files through DistortionAudioProcessor.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include <iostream>
+
+//==============================================================================
+struct RenderSettings
+{
+	// getStateInformation() blob applied to every processor instance
+	juce::MemoryBlock state;
+
+	juce::File outputDirectory;
+	juce::String outputExtension;
+	int blockSize = 4096;
+	int threads = 1;
+
+	// Channel threads of each processor, what the file workers leave over
+	int channelThreads = 1;
+};
+
+struct RenderResult
+{
+	juce::File output;
+	juce::String error;
+	double audioSeconds = 0.0;
+	double renderSeconds = 0.0;
+};
+
+//==============================================================================
+// Renders files taken from a shared queue, with one processor per worker.
+// Files are read and written in blocks of RenderSettings::blockSize, so memory
+// does not grow with file length.
+class RenderWorker : public juce::Thread
+{
+public:
+	RenderWorker(const RenderSettings& settings, const juce::Array<juce::File>& files, std::vector<RenderResult>& results, std::atomic<int>& nextFile)
+		: juce::Thread("Render worker"), m_settings(settings), m_files(files), m_results(results), m_nextFile(nextFile)
+	{
+	}
+
+	void run() override
+	{
+		juce::AudioFormatManager formatManager;
+		formatManager.registerBasicFormats();
+
+		DistortionAudioProcessor processor;
+		processor.setNonRealtime(true);
+		processor.setOfflineThreads(m_settings.channelThreads);
+		processor.setStateInformation(m_settings.state.getData(), (int)m_settings.state.getSize());
+
+		while (!threadShouldExit())
+		{
+			const int index = m_nextFile++;
+
+			if (index >= m_files.size())
+				break;
+
+			const double start = juce::Time::getMillisecondCounterHiRes();
+			m_results[index] = render(processor, formatManager, m_files[index]);
+			m_results[index].renderSeconds = 0.001 * (juce::Time::getMillisecondCounterHiRes() - start);
+		}
+	}
+
+private:
+	RenderResult render(DistortionAudioProcessor& processor, juce::AudioFormatManager& formatManager, const juce::File& input)
+	{
+		RenderResult result;
+
+		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(input));
+
+		if (reader == nullptr)
+		{
+			result.error = "cannot read input";
+			return result;
+		}
+
+		const juce::String extension = m_settings.outputExtension.isNotEmpty() ? m_settings.outputExtension : input.getFileExtension();
+		auto* format = formatManager.findFormatForFileExtension(extension);
+
+		if (format == nullptr)
+		{
+			result.error = "unsupported output format " + extension;
+			return result;
+		}
+
+		// Never overwrite the input
+		const juce::File directory = (m_settings.outputDirectory != juce::File()) ? m_settings.outputDirectory : input.getParentDirectory();
+		const juce::String suffix = (directory == input.getParentDirectory()) ? "_distortion" : "";
+		result.output = directory.getChildFile(input.getFileNameWithoutExtension() + suffix).withFileExtension(extension);
+
+		const int channels = (int)reader->numChannels;
+		const double sampleRate = reader->sampleRate;
+		const juce::int64 length = reader->lengthInSamples;
+		const int bitsPerSample = format->getPossibleBitDepths().contains((int)reader->bitsPerSample) ? (int)reader->bitsPerSample : 24;
+
+		result.output.deleteFile();
+		std::unique_ptr<juce::FileOutputStream> stream(result.output.createOutputStream());
+		std::unique_ptr<juce::AudioFormatWriter> writer;
+
+		if (stream != nullptr)
+			writer.reset(format->createWriterFor(stream.get(), sampleRate, (unsigned int)channels, bitsPerSample, {}, 0));
+
+		if (writer == nullptr)
+		{
+			result.error = "cannot write " + result.output.getFullPathName();
+			return result;
+		}
+
+		stream.release();
+
+		// Match the bus layout to the file
+		const int blockSize = m_settings.blockSize;
+		const auto channelSet = juce::AudioChannelSet::canonicalChannelSet(channels);
+
+		juce::AudioProcessor::BusesLayout layout;
+		layout.inputBuses.add(channelSet);
+		layout.outputBuses.add(channelSet);
+
+		processor.releaseResources();
+
+		if (!processor.setBusesLayout(layout))
+		{
+			result.error = "unsupported channel count " + juce::String(channels);
+			return result;
+		}
+
+		processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+		processor.prepareToPlay(sampleRate, blockSize);
+
+		// Drop the first latency samples and read past the end, which the
+		// reader fills with silence, to flush them out again
+		juce::AudioBuffer<float> buffer(channels, blockSize);
+		juce::MidiBuffer midi;
+		juce::int64 readPosition = 0;
+		juce::int64 skip = processor.getLatencySamples();
+		juce::int64 written = 0;
+
+		while (written < length && !threadShouldExit())
+		{
+			reader->read(&buffer, 0, blockSize, readPosition, true, true);
+			readPosition += blockSize;
+
+			processor.processBlock(buffer, midi);
+
+			const int skipped = (int)juce::jmin(skip, (juce::int64)blockSize);
+			const int count = (int)juce::jmin((juce::int64)(blockSize - skipped), length - written);
+			skip -= skipped;
+
+			if (count > 0 && !writer->writeFromAudioSampleBuffer(buffer, skipped, count))
+			{
+				result.error = "write failed";
+				return result;
+			}
+
+			written += count;
+		}
+
+		result.audioSeconds = (double)length / sampleRate;
+		return result;
+	}
+
+	const RenderSettings& m_settings;
+	const juce::Array<juce::File>& m_files;
+	std::vector<RenderResult>& m_results;
+	std::atomic<int>& m_nextFile;
+};
+
+//==============================================================================
+static void printUsage()
+{
+	std::cout << "Usage: DistortionRender [options] input...\n"
+	             "  --preset <file>        APVTS state as XML\n"
+	             "  --state <file>         getStateInformation blob\n"
+	             "  --param <name=value>   parameter in its own units, repeatable\n"
+	             "  --output <directory>   defaults to next to each input\n"
+	             "  --format <wav|flac>    defaults to the input format\n"
+	             "  --block <samples>      processBlock size, default 4096\n"
+	             "  --threads <count>      default one per CPU\n";
+}
+
+static juce::File resolveFile(const juce::String& path)
+{
+	return juce::File::getCurrentWorkingDirectory().getChildFile(path.unquoted());
+}
+
+// Folds the preset, state blob and --param overrides into one state blob
+static bool loadState(juce::ArgumentList& args, juce::MemoryBlock& state)
+{
+	DistortionAudioProcessor processor;
+
+	if (args.containsOption("--preset"))
+	{
+		const auto file = resolveFile(args.removeValueForOption("--preset"));
+		std::unique_ptr<juce::XmlElement> xml(juce::XmlDocument::parse(file));
+
+		if (xml == nullptr || !xml->hasTagName(processor.apvts.state.getType()))
+		{
+			std::cerr << "Invalid preset " << file.getFullPathName() << "\n";
+			return false;
+		}
+
+		juce::MemoryBlock data;
+		juce::AudioProcessor::copyXmlToBinary(*xml, data);
+		processor.setStateInformation(data.getData(), (int)data.getSize());
+	}
+
+	if (args.containsOption("--state"))
+	{
+		const auto file = resolveFile(args.removeValueForOption("--state"));
+		juce::MemoryBlock data;
+
+		if (!file.loadFileAsData(data))
+		{
+			std::cerr << "Cannot read state " << file.getFullPathName() << "\n";
+			return false;
+		}
+
+		processor.setStateInformation(data.getData(), (int)data.getSize());
+	}
+
+	while (args.containsOption("--param"))
+	{
+		const auto assignment = args.removeValueForOption("--param");
+		const auto name = assignment.upToFirstOccurrenceOf("=", false, false).trim();
+		auto* parameter = processor.apvts.getParameter(name);
+
+		if (parameter == nullptr || !assignment.contains("="))
+		{
+			std::cerr << "Unknown parameter " << assignment << "\n";
+			return false;
+		}
+
+		const float value = assignment.fromFirstOccurrenceOf("=", false, false).getFloatValue();
+		parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+	}
+
+	processor.getStateInformation(state);
+	return true;
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+	juce::ArgumentList args(argc, argv);
+
+	if (args.size() == 0 || args.containsOption("--help|-h"))
+	{
+		printUsage();
+		return 0;
+	}
+
+	RenderSettings settings;
+	settings.threads = juce::SystemStats::getNumCpus();
+
+	if (!loadState(args, settings.state))
+		return 1;
+
+	if (args.containsOption("--output"))
+	{
+		settings.outputDirectory = resolveFile(args.removeValueForOption("--output"));
+		settings.outputDirectory.createDirectory();
+	}
+
+	if (args.containsOption("--format"))
+		settings.outputExtension = "." + args.removeValueForOption("--format").trimCharactersAtStart(".");
+
+	if (args.containsOption("--block"))
+		settings.blockSize = juce::jmax(1, args.removeValueForOption("--block").getIntValue());
+
+	if (args.containsOption("--threads"))
+		settings.threads = juce::jmax(1, args.removeValueForOption("--threads").getIntValue());
+
+	juce::Array<juce::File> files;
+
+	for (const auto& argument : args.arguments)
+	{
+		if (argument.isOption())
+		{
+			std::cerr << "Unknown option " << argument.text << "\n";
+			return 1;
+		}
+
+		files.add(argument.resolveAsFile());
+	}
+
+	// Render
+	std::vector<RenderResult> results((size_t)files.size());
+	std::atomic<int> nextFile{ 0 };
+	juce::OwnedArray<RenderWorker> workers;
+
+	const int fileThreads = juce::jmin(settings.threads, files.size());
+	settings.channelThreads = juce::jmax(1, settings.threads / juce::jmax(1, fileThreads));
+
+	const double start = juce::Time::getMillisecondCounterHiRes();
+
+	for (int i = 0; i < fileThreads; ++i)
+		workers.add(new RenderWorker(settings, files, results, nextFile))->startThread();
+
+	for (auto* worker : workers)
+		worker->waitForThreadToExit(-1);
+
+	const double wallSeconds = 0.001 * (juce::Time::getMillisecondCounterHiRes() - start);
+
+	// Report
+	double audioSeconds = 0.0;
+	int failed = 0;
+
+	for (int i = 0; i < files.size(); ++i)
+	{
+		const auto& result = results[(size_t)i];
+
+		if (result.error.isNotEmpty())
+		{
+			std::cerr << files[i].getFullPathName() << ": " << result.error << "\n";
+			++failed;
+			continue;
+		}
+
+		audioSeconds += result.audioSeconds;
+		std::cout << result.output.getFullPathName() << ": " << result.audioSeconds << " s in " << result.renderSeconds << " s, "
+		          << result.audioSeconds / juce::jmax(result.renderSeconds, 1.0e-9) << "x realtime\n";
+	}
+
+	std::cout << files.size() - failed << " files, " << audioSeconds << " s of audio in " << wallSeconds << " s on " << workers.size() << " threads, "
+	          << audioSeconds / juce::jmax(wallSeconds, 1.0e-9) << "x realtime\n";
+
+	return failed == 0 ? 0 : 1;
+}